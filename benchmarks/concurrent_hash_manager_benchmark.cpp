@@ -0,0 +1,70 @@
+#include <sbpl_utils/examples/hashable_states.h>
+#include <sbpl_utils/hash_manager/concurrent_hash_manager.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace sbpl_utils;
+using namespace std;
+
+// Every thread interns its share of a fixed workload of successor states. Half
+// of each thread's successors are duplicates that another thread also
+// generates, mimicking parallel expansions that reach the same states.
+double BENCHMARK_THREADS(int num_threads, int num_successors) {
+  ConcurrentHashManager<StateDiscVector> hash_manager;
+  vector<thread> threads;
+  const int successors_per_thread = num_successors / num_threads;
+  const auto start = chrono::steady_clock::now();
+
+  for (int thread_id = 0; thread_id < num_threads; ++thread_id) {
+    threads.emplace_back([&, thread_id]() {
+      const int begin = thread_id * successors_per_thread;
+
+      for (int ii = begin; ii < begin + successors_per_thread; ++ii) {
+        const int state = ii % 2 == 0 ? ii : ii / 2;
+        hash_manager.GetStateIDForceful(StateDiscVector({state % 97, state % 89, state % 83, state / 97, 0, 1, 2}));
+      }
+    });
+  }
+
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  const auto end = chrono::steady_clock::now();
+  return chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv) {
+  const int num_successors = argc > 1 ? atoi(argv[1]) : 2000000;
+  const int max_threads = argc > 2 ? atoi(argv[2]) :
+                          max(1u, thread::hardware_concurrency());
+
+  // Powers of two up to, and always including, max_threads.
+  vector<int> thread_counts;
+
+  for (int num_threads = 1; num_threads < max_threads; num_threads *= 2) {
+    thread_counts.push_back(num_threads);
+  }
+
+  thread_counts.push_back(max_threads);
+  double single_thread_seconds = 0.0;
+
+  for (int num_threads : thread_counts) {
+    const double seconds = BENCHMARK_THREADS(num_threads, num_successors);
+
+    if (num_threads == 1) {
+      single_thread_seconds = seconds;
+    }
+
+    printf("threads: %3d  time: %7.3f s  throughput: %7.2f M successors/s  speedup: %5.2fx\n",
+           num_threads, seconds, num_successors / seconds / 1e6,
+           single_thread_seconds / seconds);
+  }
+
+  return 0;
+}
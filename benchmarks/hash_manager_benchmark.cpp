@@ -0,0 +1,296 @@
+#include <sbpl_utils/examples/hashable_states.h>
+#include <sbpl_utils/hash_manager/dense_grid_hash_manager.h>
+#include <sbpl_utils/hash_manager/hash_manager.h>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+using namespace sbpl_utils;
+using namespace std;
+
+// Track live heap bytes by prefixing every allocation with its size. This
+// counts requested bytes only, so malloc's own bookkeeping is not included.
+namespace {
+size_t g_live_bytes = 0;
+constexpr size_t kHeaderSize = 16;
+}
+
+// Kept out of line so that the size prefix is never visible to the optimizer
+// at the call sites.
+__attribute__((noinline)) void *operator new(size_t size) {
+  char *block = static_cast<char *>(malloc(size + kHeaderSize));
+
+  if (block == nullptr) {
+    throw std::bad_alloc();
+  }
+
+  *reinterpret_cast<size_t *>(block) = size;
+  g_live_bytes += size;
+  return block + kHeaderSize;
+}
+
+__attribute__((noinline)) void operator delete(void *ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+
+  char *block = static_cast<char *>(ptr) - kHeaderSize;
+  g_live_bytes -= *reinterpret_cast<size_t *>(block);
+  free(block);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  operator delete(ptr);
+}
+
+template <class HashManagerType, class StateGenerator, class... Args>
+void BENCHMARK_INSERT(const char *name, int num_states,
+                      StateGenerator generator, Args... hash_manager_args) {
+  typedef decltype(generator(0)) HashableState;
+  vector<HashableState> states;
+  states.reserve(num_states);
+
+  for (int ii = 0; ii < num_states; ++ii) {
+    states.push_back(generator(ii));
+  }
+
+  const size_t bytes_before = g_live_bytes;
+  HashManagerType hash_manager(hash_manager_args...);
+  const auto start = chrono::steady_clock::now();
+
+  for (const auto &state : states) {
+    hash_manager.GetStateIDForceful(state);
+  }
+
+  const auto mid = chrono::steady_clock::now();
+  size_t found = 0;
+
+  for (const auto &state : states) {
+    found += hash_manager.Exists(state);
+  }
+
+  const auto end = chrono::steady_clock::now();
+  const size_t bytes = g_live_bytes - bytes_before;
+  const double insert_ns = chrono::duration<double, nano>(mid - start).count();
+  const double lookup_ns = chrono::duration<double, nano>(end - mid).count();
+
+  printf("%-30s states: %9zu  bytes/state: %7.1f  insert: %6.1f ns  lookup: %6.1f ns\n",
+         name, hash_manager.Size(), static_cast<double>(bytes) / num_states,
+         insert_ns / num_states, lookup_ns / num_states);
+
+  if (found != states.size()) {
+    printf("  ERROR: only found %zu of %zu states\n", found, states.size());
+  }
+}
+
+// Interns successors the way an environment's GetSuccs would, one expansion
+// at a time, either per successor or as one batch per expansion. Successors
+// are scattered over the state space, as with lattice moves on a big map.
+template <class HashManagerType, class StateGenerator>
+void BENCHMARK_BATCH(const char *name, int num_states, int num_successors,
+                     StateGenerator generator) {
+  typedef decltype(generator(0)) HashableState;
+  vector<vector<HashableState>> expansions(num_states / num_successors);
+
+  for (size_t expansion = 0; expansion < expansions.size(); ++expansion) {
+    for (int ii = 0; ii < num_successors; ++ii) {
+      expansions[expansion].push_back(generator((expansion * 7919 + ii * 104729) %
+                                                num_states));
+    }
+  }
+
+  double seconds[2];
+
+  for (int batched = 0; batched < 2; ++batched) {
+    HashManagerType hash_manager;
+    vector<unsigned int> successor_ids;
+    const auto start = chrono::steady_clock::now();
+
+    for (const auto &successors : expansions) {
+      if (batched) {
+        hash_manager.GetStateIDsForceful(successors, &successor_ids);
+      } else {
+        successor_ids.clear();
+
+        for (const auto &successor : successors) {
+          successor_ids.push_back(hash_manager.GetStateIDForceful(successor));
+        }
+      }
+    }
+
+    seconds[batched] = chrono::duration<double, nano>(chrono::steady_clock::now() -
+                                                      start).count();
+  }
+
+  const double num_calls = static_cast<double>(expansions.size()) * num_successors;
+  printf("%-30s per-successor: %6.1f ns  batched: %6.1f ns\n", name,
+         seconds[0] / num_calls, seconds[1] / num_calls);
+}
+
+// Compares rebuilding a table state by state with warm-starting it from a
+// snapshot file.
+template <class HashManagerType, class StateGenerator>
+void BENCHMARK_SNAPSHOT(const char *name, int num_states,
+                        StateGenerator generator) {
+  const char *path = "/tmp/hash_manager_benchmark_snapshot.bin";
+  HashManagerType hash_manager;
+  const auto start = chrono::steady_clock::now();
+
+  for (int ii = 0; ii < num_states; ++ii) {
+    hash_manager.GetStateIDForceful(generator(ii));
+  }
+
+  const auto built = chrono::steady_clock::now();
+  hash_manager.SaveSnapshot(path);
+
+  HashManagerType warm_started;
+  const auto load_start = chrono::steady_clock::now();
+  warm_started.LoadSnapshot(path);
+  const auto loaded = chrono::steady_clock::now();
+
+  printf("%-30s rebuild: %7.2f ms  warm start: %7.2f ms\n", name,
+         chrono::duration<double, milli>(built - start).count(),
+         chrono::duration<double, milli>(loaded - load_start).count());
+  remove(path);
+}
+
+// Runs many short queries on one hash manager, resetting it in between, with
+// and without keeping the memory across resets.
+template <class HashManagerType, class StateGenerator>
+void BENCHMARK_RESET(const char *name, int num_queries, int states_per_query,
+                     StateGenerator generator) {
+  double seconds[2];
+
+  for (int retain = 0; retain < 2; ++retain) {
+    HashManagerType hash_manager;
+    hash_manager.SetMaxRetainedStates(retain ? states_per_query : 0);
+    const auto start = chrono::steady_clock::now();
+
+    for (int query = 0; query < num_queries; ++query) {
+      for (int ii = 0; ii < states_per_query; ++ii) {
+        hash_manager.GetStateIDForceful(generator(query + ii));
+      }
+
+      hash_manager.Reset();
+    }
+
+    seconds[retain] = chrono::duration<double, micro>(chrono::steady_clock::now() -
+                                                      start).count();
+  }
+
+  printf("%-30s per query: release %8.1f us  retain %8.1f us\n", name,
+         seconds[0] / num_queries, seconds[1] / num_queries);
+}
+
+// Runs many searches, each with its own search-local hash manager, drawing
+// memory from the default allocator or from an arena that is released after
+// every search.
+template <class StateIndex, class StateGenerator>
+void BENCHMARK_ARENA(const char *name, int num_queries, int states_per_query,
+                     StateGenerator generator) {
+  typedef decltype(generator(0)) HashableState;
+  typedef ArenaAllocator<HashableState> Allocator;
+  double seconds[2];
+
+  for (int use_arena = 0; use_arena < 2; ++use_arena) {
+    MonotonicArena arena;
+    const auto start = chrono::steady_clock::now();
+
+    for (int query = 0; query < num_queries; ++query) {
+      if (use_arena) {
+        HashManager<HashableState, StateIndex, Allocator> hash_manager((Allocator(
+                                                                          &arena)));
+
+        for (int ii = 0; ii < states_per_query; ++ii) {
+          hash_manager.GetStateIDForceful(generator(query + ii));
+        }
+      } else {
+        HashManager<HashableState, StateIndex> hash_manager;
+
+        for (int ii = 0; ii < states_per_query; ++ii) {
+          hash_manager.GetStateIDForceful(generator(query + ii));
+        }
+      }
+
+      arena.Release();
+    }
+
+    seconds[use_arena] = chrono::duration<double, micro>(chrono::steady_clock::now()
+                                                         - start).count();
+  }
+
+  printf("%-30s per query: default %8.1f us  arena %8.1f us\n", name,
+         seconds[0] / num_queries, seconds[1] / num_queries);
+}
+
+int main(int argc, char **argv) {
+  const int num_states = argc > 1 ? atoi(argv[1]) : 200000;
+  const int width = 500;
+
+  auto xy = [width](int ii) {
+    return StateXY(ii % width, ii / width);
+  };
+  auto xytheta = [width](int ii) {
+    return StateXYTheta(ii % width, (ii / width) % width, ii / (width * width));
+  };
+  auto disc_vector = [](int ii) {
+    return StateDiscVector({ii % 7, ii % 11, ii % 13, ii % 17, ii % 19, ii % 23, ii / 7});
+  };
+  auto disc_array = [](int ii) {
+    return StateDiscArray<7, int16_t>({ii % 7, ii % 11, ii % 13, ii % 17, ii % 19, ii % 23, ii / 7});
+  };
+
+  BENCHMARK_INSERT<HashManager<StateXY>>("StateXY", num_states, xy);
+  BENCHMARK_INSERT<HashManager<StateXYTheta>>("StateXYTheta", num_states,
+                                              xytheta);
+  BENCHMARK_INSERT<HashManager<StateDiscVector>>("StateDiscVector (7 DOF)",
+                                                 num_states, disc_vector);
+  BENCHMARK_INSERT<HashManager<StateDiscArray<7, int16_t>>>("StateDiscArray<7, int16>",
+                                                            num_states, disc_array);
+
+  BENCHMARK_INSERT<FlatHashManager<StateXY>>("Flat StateXY", num_states, xy);
+  BENCHMARK_INSERT<FlatHashManager<StateXYTheta>>("Flat StateXYTheta",
+                                                  num_states, xytheta);
+  BENCHMARK_INSERT<FlatHashManager<StateDiscVector>>("Flat StateDiscVector (7 DOF)",
+                                                     num_states, disc_vector);
+  BENCHMARK_INSERT<FlatHashManager<StateDiscArray<7, int16_t>>>("Flat StateDiscArray<7, int16>",
+                                                                num_states, disc_array);
+
+  // Bounds just large enough for the generated states.
+  const int max_theta = (num_states - 1) / (width * width);
+  BENCHMARK_INSERT<DenseGridHashManager<StateXY>>("Dense StateXY", num_states, xy,
+                                                  array<int, 2> {{0, 0}},
+                                                  array<int, 2> {{width - 1, (num_states - 1) / width}});
+  BENCHMARK_INSERT<DenseGridHashManager<StateXYTheta>>("Dense StateXYTheta",
+                                                       num_states, xytheta, array<int, 3> {{0, 0, 0}},
+                                                       array<int, 3> {{width - 1, width - 1, max_theta}});
+
+  printf("\nInterning 32 successors per expansion:\n");
+  BENCHMARK_BATCH<HashManager<StateDiscVector>>("StateDiscVector (7 DOF)",
+                                                num_states, 32, disc_vector);
+  BENCHMARK_BATCH<FlatHashManager<StateDiscVector>>("Flat StateDiscVector (7 DOF)",
+                                                    num_states, 32, disc_vector);
+  BENCHMARK_BATCH<FlatHashManager<StateDiscArray<7, int16_t>>>("Flat StateDiscArray<7, int16>",
+                                                               num_states, 32, disc_array);
+
+  printf("\n1000 queries of 2000 states:\n");
+  BENCHMARK_RESET<HashManager<StateXYTheta>>("StateXYTheta", 1000, 2000,
+                                             xytheta);
+  BENCHMARK_RESET<FlatHashManager<StateXYTheta>>("Flat StateXYTheta", 1000, 2000,
+                                                 xytheta);
+
+  printf("\n1000 searches of 2000 states, allocator:\n");
+  BENCHMARK_ARENA<ChainedStateIndex>("StateXYTheta", 1000, 2000, xytheta);
+  BENCHMARK_ARENA<FlatStateIndex>("Flat StateXYTheta", 1000, 2000, xytheta);
+
+  printf("\nSnapshots:\n");
+  BENCHMARK_SNAPSHOT<FlatHashManager<StateXYTheta>>("Flat StateXYTheta",
+                                                    num_states, xytheta);
+  BENCHMARK_SNAPSHOT<FlatHashManager<StateDiscArray<7, int16_t>>>("Flat StateDiscArray<7, int16>",
+                                                                  num_states, disc_array);
+  return 0;
+}
@@ -1,9 +1,8 @@
 #include <sbpl_utils/examples/hashable_states.h>
+#include <sbpl_utils/hash_manager/hash_utils.h>
 
 #include <iostream>
 
-using std::hash;
-
 namespace sbpl_utils {
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -16,7 +15,7 @@ bool StateXY::operator==(const StateXY &other) const {
   return x_ == other.x() && y_ == other.y();
 }
 size_t StateXY::GetHash() const {
-  return hash<int>()(x_) ^ hash<int>()(y_);
+  return HashValues(x_, y_);
 }
 std::ostream &operator<< (std::ostream &stream, const StateXY &state) {
   stream << "(" << state.x() << ", " << state.y() << ")";
@@ -28,13 +27,13 @@ std::ostream &operator<< (std::ostream &stream, const StateXY &state) {
 ///////////////////////////////////////////////////////////////////////////////
 
 StateXYTheta::StateXYTheta() : x_(0), y_(0), theta_(0) {}
-StateXYTheta::StateXYTheta(int x, int y, int theta) : x_(0), y_(y),
+StateXYTheta::StateXYTheta(int x, int y, int theta) : x_(x), y_(y),
   theta_(theta) {}
 bool StateXYTheta::operator==(const StateXYTheta &other) const {
   return x_ == other.x() && y_ == other.y() && theta_ == other.theta();
 }
 size_t StateXYTheta::GetHash() const {
-  return hash<int>()(x_) ^ hash<int>()(y_) ^ hash<int>()(theta_);
+  return HashValues(x_, y_, theta_);
 }
 std::ostream &operator<< (std::ostream &stream, const StateXYTheta &state) {
   stream << "(" << state.x() << ", " << state.y() <<  ", " << state.theta() << ")";
@@ -52,10 +51,10 @@ bool StateDiscVector::operator==(const StateDiscVector &other) const {
   return coords_ == other.coords();
 }
 size_t StateDiscVector::GetHash() const {
-  size_t hash_value = 0;
+  size_t hash_value = coords_.size();
 
   for (const auto &coord : coords_) {
-    hash_value ^= hash<int>()(coord);
+    hash_value = HashCombine(hash_value, static_cast<uint64_t>(coord));
   }
 
   return hash_value;
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+
+namespace sbpl_utils {
+
+// Monotonic ("bump pointer") memory arena. Memory is carved sequentially out
+// of large blocks and never returned individually: deallocation is a no-op,
+// and Release() (or destroying the arena) frees everything at once. This
+// suits search-local data structures, which grow during a search and are all
+// discarded together afterwards, and avoids contention on the global heap
+// when several planners run in one process. An arena is not thread-safe; use
+// one per search thread.
+//
+// Since freed memory is not reused, containers that grow geometrically in an
+// arena leave their old buffers behind, roughly doubling their footprint.
+class MonotonicArena {
+ public:
+  explicit MonotonicArena(size_t initial_block_size = 64 * 1024);
+  ~MonotonicArena();
+
+  MonotonicArena(const MonotonicArena &) = delete;
+  MonotonicArena &operator=(const MonotonicArena &) = delete;
+
+  // Returns num_bytes of memory aligned to alignment, which must be a power of
+  // two.
+  void *Allocate(size_t num_bytes, size_t alignment);
+
+  // Frees all blocks. Everything allocated from the arena becomes invalid.
+  void Release();
+
+  // Bytes handed out by Allocate() since the last Release().
+  size_t BytesAllocated() const {
+    return bytes_allocated_;
+  }
+  // Bytes held in blocks.
+  size_t BytesReserved() const {
+    return bytes_reserved_;
+  }
+
+ private:
+  struct Block {
+    Block *previous;
+    size_t size;
+  };
+
+  // Allocates a block with room for at least num_bytes after alignment.
+  void AddBlock(size_t num_bytes, size_t alignment);
+
+  const size_t initial_block_size_;
+  size_t next_block_size_;
+  Block *current_block_ = nullptr;
+  char *cursor_ = nullptr;
+  char *end_ = nullptr;
+  size_t bytes_allocated_ = 0;
+  size_t bytes_reserved_ = 0;
+};
+
+// Standard allocator that draws from a MonotonicArena, for use with standard
+// containers and as the Allocator parameter of HashManager. Copies (including
+// rebound ones) share the arena, which must outlive them and everything
+// allocated through them.
+template <typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(MonotonicArena *arena) : arena_(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena()) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T *, size_t) {}
+
+  MonotonicArena *arena() const {
+    return arena_;
+  }
+
+ private:
+  MonotonicArena *arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+  return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+  return !(lhs == rhs);
+}
+}  // namespace sbpl_utils
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace sbpl_utils {
+
+// Epoch-based memory reclamation for one writer and up to kMaxReaders
+// concurrent readers of a shared data structure.
+//
+// Readers bracket every access with Enter() and Exit(); between the two, any
+// pointer they load from the shared structure stays valid. The writer never
+// frees memory that readers might still reference directly: it unpublishes it
+// and hands a deleter to Retire(), and Reclaim() later runs the deleters of
+// everything retired before the oldest epoch a reader is still in. Neither
+// side ever waits for the other: a reader that stays inside Enter()/Exit()
+// indefinitely only delays reclamation.
+//
+// Reader slots are claimed with RegisterReader() and may be used by one
+// thread at a time. Retire() and Reclaim() must be called from the writer
+// thread.
+class EpochDomain {
+ public:
+  static constexpr size_t kMaxReaders = 64;
+
+  EpochDomain();
+  // Runs the deleters of all retired objects. No reader may be inside
+  // Enter()/Exit().
+  ~EpochDomain();
+
+  EpochDomain(const EpochDomain &) = delete;
+  EpochDomain &operator=(const EpochDomain &) = delete;
+
+  // Claims a free reader slot. Throws error if all slots are taken.
+  size_t RegisterReader();
+  void UnregisterReader(size_t slot);
+
+  void Enter(size_t slot);
+  void Exit(size_t slot);
+
+  // Schedules deleter to run once no reader can reference the retired object.
+  // The object must already be unreachable for readers entering from now on.
+  void Retire(std::function<void()> deleter);
+
+  // Runs the deleters that are safe to run. Returns the number of retired
+  // objects still pending.
+  size_t Reclaim();
+
+  size_t NumPending() const {
+    return retired_.size();
+  }
+
+ private:
+  // Epoch a reader entered in, or kInactive.
+  static constexpr uint64_t kInactive = 0;
+
+  struct ReaderSlot {
+    std::atomic<uint64_t> epoch;
+    std::atomic<bool> in_use;
+    // Keep neighbouring readers' slots off the same cache line.
+    char padding[64];
+  };
+
+  std::atomic<uint64_t> global_epoch_;
+  ReaderSlot slots_[kMaxReaders];
+  // (epoch retired in, deleter) pairs, in increasing epoch order.
+  std::vector<std::pair<uint64_t, std::function<void()>>> retired_;
+};
+}  // namespace sbpl_utils
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace sbpl_utils {
+
+// Read-only memory mapping of a whole file. The mapping is released when the
+// MappedFile is destroyed, so pointers into data() must not outlive it.
+class MappedFile {
+ public:
+  // Throws error if the file cannot be opened or mapped.
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other);
+  MappedFile &operator=(MappedFile &&other);
+
+  // Start of the mapping (page-aligned), or nullptr for an empty file.
+  const char *data() const {
+    return data_;
+  }
+  size_t size() const {
+    return size_;
+  }
+  const std::string &path() const {
+    return path_;
+  }
+
+ private:
+  void Unmap();
+
+  std::string path_;
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+};
+}  // namespace sbpl_utils
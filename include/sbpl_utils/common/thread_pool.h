@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sbpl_utils {
+
+// Fixed-size pool of worker threads for fork-join parallelism, e.g. for
+// evaluating all out-edges of an expanded vertex at once. The calling thread
+// takes part in the work, so a pool of N threads starts N - 1 workers.
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t num_threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Number of threads that run tasks, including the calling thread.
+  size_t NumThreads() const {
+    return workers_.size() + 1;
+  }
+
+  // Runs fn(0), ..., fn(num_tasks - 1) on the pool and the calling thread and
+  // returns once all of them have finished. Tasks are handed out
+  // dynamically, so they may run in any order and on any thread. If a task
+  // throws, the first exception is rethrown here once the others are done.
+  // Must not be called concurrently or from within a task.
+  void ParallelFor(size_t num_tasks, const std::function<void(size_t)> &fn);
+
+ private:
+  void WorkerLoop();
+  // Runs tasks of the current job until there are none left.
+  void RunTasks();
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable job_ready_;
+  std::condition_variable job_done_;
+  // Incremented for every job, so workers notice new ones.
+  uint64_t job_generation_ = 0;
+  bool stopping_ = false;
+
+  const std::function<void(size_t)> *job_ = nullptr;
+  size_t num_tasks_ = 0;
+  std::atomic<size_t> next_task_;
+  // Workers still inside the current job.
+  size_t num_busy_workers_ = 0;
+  std::exception_ptr exception_;
+};
+}  // namespace sbpl_utils
@@ -1,9 +1,24 @@
 #pragma once
 
 #include <sbpl/headers.h>
-
+#include <sbpl_utils/common/thread_pool.h>
+#include <sbpl_utils/environments/compiled_graph.h>
+#include <sbpl_utils/environments/roadmap_file.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iterator>
 #include <limits>
 #include <map>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <boost/graph/graph_traits.hpp>
@@ -52,6 +67,49 @@ namespace sbpl_utils {
 // std::unique_ptr<SBPLPlanner> planner(new ARAPlanner(&bg));
 // planner->(..do stuff..)
 // Look at boost_environment_test.cpp for more usage examples.
+//
+// The graph is compiled into a CompiledGraph (CSR arrays of targets and
+// costs, plus the vertex heuristics) at construction, and successors are read
+// from there rather than through boost's iterators and property maps.
+// Derived classes that modify graph_ afterwards must call CompileGraph() for
+// the changes to take effect.
+//
+// The environment copies the graph it is constructed from, or takes it over
+// if it is moved in. Several environments (e.g. one per query thread) can
+// instead share one immutable graph through a std::shared_ptr<const Graph>.
+// Their costs, heuristics and evaluations are then kept in the compiled
+// graph only, per environment, and graph_ is left empty. The same holds for
+// environments loaded from a RoadmapFile, which are compiled directly from
+// the file without a boost graph; CompileGraph() must not be called on them.
+// Edge probabilities and recorded evaluation times are compiled, too (see
+// EdgeProbability() and EdgeEvaluationTime()).
+//
+// For lazy planners (e.g. LazyARAPlanner), an EdgeEvaluator can be set that
+// computes the true cost of an edge on demand, e.g. by collision checking it.
+// GetLazySuccs() then reports the graph's edge costs as optimistic estimates,
+// and only GetTrueCost() runs the evaluator. Evaluations are memoized per
+// edge, so every edge is evaluated at most once (once per direction for
+// undirected graphs), and edges already known are reported with their true
+// cost, or dropped if they turned out to be infeasible.
+//
+// With SetNumEvaluationThreads(), the pending out-edges of an expanded vertex
+// (or a batch of pending lazy edges, see EvaluateEdges()) are evaluated
+// concurrently on a thread pool. Results do not depend on the number of
+// threads. The time spent evaluating each edge is recorded, and also stored
+// in the edge bundle's evaluation_time if it has one (e.g.
+// EdgeWithCostAndProbability) and the environment owns the graph. Both
+// directions of an undirected edge share one bundle, which keeps the time of
+// the direction evaluated last; EdgeEvaluationTime() is per direction.
+//
+// For replanning, edge costs and heuristics can be updated and edges or
+// vertices removed in place, without recompiling the graph. Cost and
+// heuristic updates are also written to graph_ if the environment owns it,
+// while removed edges stay in graph_ (and are restored by CompileGraph()).
+// The IDs of the states affected by updates are logged for incremental
+// planners (e.g. ADPlanner) to consume through GetChangedStateIDs().
+//
+// Instead of the graph's heuristics, ComputeGoalHeuristics() can set every
+// state's heuristic to its exact cost-to-go to a goal in the compiled graph.
 
 GRAPH_TEMPLATE
 class BGEnvironment : public virtual DiscreteSpaceInformation {
@@ -67,12 +125,106 @@ class BGEnvironment : public virtual DiscreteSpaceInformation {
 
 
   BGEnvironment(const Graph &g);
+  BGEnvironment(Graph &&g);
+  BGEnvironment(std::shared_ptr<const Graph> g);
+  BGEnvironment(const RoadmapFile &roadmap);
   ~BGEnvironment();
   virtual void GetSuccs(int parent_id, std::vector<int> *succ_ids,
                         std::vector<int> *costs) override;
   virtual void GetLazySuccs(int parent_id, std::vector<int> *succ_ids,
                             std::vector<int> *costs, std::vector<bool> *true_costs) override;
+  // Predecessors come from the compiled graph's reverse index, for backward
+  // and bidirectional search. Costs are those of the edges from the
+  // predecessors to child_id, evaluated as in GetSuccs() and GetLazySuccs().
+  virtual void GetPreds(int child_id, std::vector<int> *pred_ids,
+                        std::vector<int> *costs) override;
+  virtual void GetLazyPreds(int child_id, std::vector<int> *pred_ids,
+                            std::vector<int> *costs, std::vector<bool> *true_costs) override;
   virtual int GetGoalHeuristic(int state_id) override;
+  // True cost of the edge from parent_id to child_id: the evaluated cost if an
+  // edge evaluator is set, the graph's cost otherwise. -1 if there is no such
+  // edge or it is infeasible.
+  virtual int GetTrueCost(int parent_id, int child_id) override;
+
+  // Computes the true cost of the edge with the given ID (see CompiledGraph)
+  // from source_id to target_id, or -1 if the edge is infeasible. True costs
+  // must not be smaller than the graph's costs for lazy search to remain
+  // correct. With more than one evaluation thread, the evaluator is called
+  // concurrently and must be thread-safe.
+  typedef std::function<int(int source_id, int target_id, size_t edge_id)>
+  EdgeEvaluator;
+
+  // Makes GetSuccs() report evaluated costs and GetLazySuccs() optimistic
+  // ones. Forgets all memoized evaluations. An empty evaluator turns lazy
+  // evaluation off.
+  void SetEdgeEvaluator(EdgeEvaluator edge_evaluator);
+
+  // Number of times the edge evaluator has run.
+  size_t NumEdgeEvaluations() const {
+    return num_edge_evaluations_;
+  }
+
+  // Evaluate edges on num_threads threads (including the planner's). 1, the
+  // default, evaluates serially.
+  void SetNumEvaluationThreads(size_t num_threads) {
+    thread_pool_.reset(num_threads > 1 ? new ThreadPool(num_threads) : nullptr);
+  }
+
+  // Evaluates all (parent ID, child ID) edges that have not been evaluated
+  // yet as one batch, e.g. the pending lazy edges of a search, so that later
+  // GetTrueCost() calls for them are lookups.
+  void EvaluateEdges(const std::vector<std::pair<int, int>> &edges);
+
+  // Seconds last spent evaluating the edge with the given ID (see
+  // CompiledGraph), or 0 if it was never evaluated. Evaluation times recorded
+  // in the graph's edge bundles or in a roadmap file count, until the edge is
+  // evaluated again.
+  double EdgeEvaluationTime(size_t edge_id) const {
+    return edge_id < evaluation_times_.size() ? evaluation_times_[edge_id] : 0.0;
+  }
+
+  // Probability that the edge with the given ID exists, from the graph's edge
+  // bundles or a roadmap file, or 1 if they do not have one.
+  double EdgeProbability(size_t edge_id) const {
+    return edge_id < edge_probabilities_.size() ? edge_probabilities_[edge_id] :
+           1.0;
+  }
+
+  // Sets the cost of all edges from parent_id to child_id (in both directions
+  // for undirected graphs), restoring them if they were removed. Forgets their
+  // memoized evaluations. Returns false if there is no such edge. Throws error
+  // if cost is negative.
+  bool UpdateEdgeCost(int parent_id, int child_id, int cost);
+  // Removes all edges from parent_id to child_id (in both directions for
+  // undirected graphs). Returns false if there is no such edge.
+  bool RemoveEdge(int parent_id, int child_id);
+  // Removes all edges into and out of state_id.
+  void RemoveVertex(int state_id);
+  // Overrides any goal heuristics (see ComputeGoalHeuristics()).
+  void UpdateHeuristic(int state_id, int heuristic);
+
+  // Replaces state_ids with the sorted IDs of the states whose edges or
+  // heuristic changed since the last call, and clears the log.
+  void GetChangedStateIDs(std::vector<int> *state_ids);
+
+  // Sets the heuristic of every state to the cost of its cheapest path to
+  // goal_id in the compiled graph (INFINITECOST if there is none), by a
+  // backward Dijkstra search over predecessors, and logs the states whose
+  // heuristic changed. With an edge evaluator, the graph's costs are
+  // optimistic, so the heuristics remain admissible. After edge updates or
+  // recompilation, the heuristics are recomputed for the same goal before
+  // they are next read or changes are next reported, so they never go stale.
+  // Throws error if goal_id is not a state ID.
+  //
+  // The costs-to-go of the most recently used goals are cached, so that
+  // switching back to one of them is a copy. Each cached goal takes one int
+  // per state, so only SetMaxCachedGoals() goals (1 by default) are kept,
+  // until edges are updated or ClearCachedGoalHeuristics() is called.
+  void ComputeGoalHeuristics(int goal_id);
+  void SetMaxCachedGoals(size_t max_cached_goals);
+  void ClearCachedGoalHeuristics() {
+    goal_heuristics_.clear();
+  }
 
   // Unused methods, need dummy definitions to make them non-abstract.
   virtual bool InitializeEnv(const char *) override {};
@@ -83,7 +235,6 @@ class BGEnvironment : public virtual DiscreteSpaceInformation {
   virtual int GetStartHeuristic(int) override {
     return 0;
   }
-  virtual void GetPreds(int, std::vector<int> *, std::vector<int> *) override {}
   virtual void SetAllActionsandAllOutcomes(CMDPSTATE *) override {}
   virtual void SetAllPreds(CMDPSTATE *) override {}
   virtual int SizeofCreatedEnv() override {
@@ -92,78 +243,680 @@ class BGEnvironment : public virtual DiscreteSpaceInformation {
   virtual void PrintState(int, bool, FILE *) override {};
   virtual void PrintEnv_Config(FILE *) override {};
 
+  const CompiledGraph &compiled_graph() const {
+    return compiled_graph_;
+  }
+
+  // The graph the environment was constructed from, whether owned or shared
+  // (empty for roadmaps).
+  const Graph &graph() const {
+    return shared_graph_ ? *shared_graph_ : graph_;
+  }
+
   // Allow derived classes to access these.
  protected:
+  // Rebuilds compiled_graph_ from graph_. Forgets all memoized evaluations,
+  // since edge IDs may change.
+  void CompileGraph();
+
+  // Memoized true cost of an edge, running the evaluator if needed.
+  int EvaluateEdge(int source_id, size_t edge_id);
+  // Evaluates distinct, unevaluated (source ID, edge ID) edges, concurrently
+  // if there is a thread pool.
+  void EvaluateEdgeBatch(const std::vector<std::pair<int, size_t>> &edges);
+
+  // Empty if the graph is not owned, in which case the property maps must not
+  // be used either.
   Graph graph_;
   decltype(get(&VertexType::heuristic, graph_)) heuristic_map_;
   decltype(get(&EdgeType::cost, graph_)) edge_cost_map_;
+  std::shared_ptr<const Graph> shared_graph_;
+  // Whether graph_ is the environment's graph, and updates are written to it.
+  bool owns_graph_ = true;
+  CompiledGraph compiled_graph_;
+  // Vertex heuristics by state ID.
+  std::vector<int> heuristics_;
+
+ private:
+  // Marks edges that have not been evaluated in true_costs_.
+  static constexpr int kUnevaluatedCost = std::numeric_limits<int>::min();
+  // Marks infeasible edges in true_costs_, as returned by the evaluator.
+  static constexpr int kInfeasibleCost = -1;
+
+  void ResetEdgeEvaluations() {
+    const size_t num_edges = edge_evaluator_ ? compiled_graph_.NumEdges() : 0;
+    true_costs_.assign(num_edges, kUnevaluatedCost);
+
+    // Recorded evaluation times are kept.
+    if (evaluation_times_.size() < num_edges) {
+      evaluation_times_.resize(num_edges, 0.0);
+    }
+
+    // Removed edges are known to be infeasible.
+    for (size_t edge_id = 0; edge_id < num_edges; ++edge_id) {
+      if (compiled_graph_.IsRemoved(edge_id)) {
+        true_costs_[edge_id] = kInfeasibleCost;
+      }
+    }
+  }
+
+  // Calls update(edge_id) for every edge from parent_id to child_id, and for
+  // every edge from child_id to parent_id if the graph is undirected. Logs
+  // both states if there are any. Returns whether there are any.
+  template <class EdgeUpdate>
+  bool ForEachEdgeBetween(int parent_id, int child_id, EdgeUpdate update);
+
+  // Common to all constructors, once the graph is compiled.
+  void Initialize();
+
+  // Fills costs_to_go with the cost of every state's cheapest path to
+  // goal_id, capped at INFINITECOST.
+  void ComputeCostsToGo(int goal_id, std::vector<int> *costs_to_go) const;
+  // Marks the goal heuristics, if any, for recomputation.
+  void InvalidateGoalHeuristics() {
+    goal_heuristics_.clear();
+    goal_heuristics_stale_ = heuristic_goal_id_ >= 0;
+  }
+
+  // Runs the evaluator on one edge, storing the result and the time taken.
+  // Safe to call concurrently for different edges.
+  void RunEdgeEvaluator(int source_id, size_t edge_id);
+
+  // Copies the evaluation time of an edge to its bundle, if it has an
+  // evaluation_time member and the environment owns the graph.
+  void StoreEvaluationTime(size_t edge_id, std::true_type);
+  void StoreEvaluationTime(size_t, std::false_type) {}
+
+  EdgeEvaluator edge_evaluator_;
+  // Memoized evaluator results by edge ID, if an evaluator is set.
+  std::vector<int> true_costs_;
+  // Evaluation times by edge ID, as recorded in the graph or roadmap and then
+  // by the evaluator, or empty.
+  std::vector<double> evaluation_times_;
+  // Edge probabilities by edge ID, or empty.
+  std::vector<double> edge_probabilities_;
+  // graph_ edges by edge ID if the environment owns the graph, or empty.
+  std::vector<Edge> graph_edges_;
+  size_t num_edge_evaluations_ = 0;
+  std::unique_ptr<ThreadPool> thread_pool_;
+
+  // IDs of states affected by updates since the last GetChangedStateIDs(),
+  // possibly with duplicates.
+  std::vector<int> changed_state_ids_;
+
+  // Cost-to-go of every state by goal ID, see ComputeGoalHeuristics(), the
+  // most recently used goal last.
+  std::vector<std::pair<int, std::vector<int>>> goal_heuristics_;
+  size_t max_cached_goals_ = 1;
+  // Goal whose costs-to-go heuristics_ holds, or -1, and whether they must
+  // be recomputed because edges changed since.
+  int heuristic_goal_id_ = -1;
+  bool goal_heuristics_stale_ = false;
+
+  // Backing store of the legacy StateID2IndexMapping entries, which point
+  // into it: NUMOFINDICES_STATEID2IND ints per vertex.
+  std::vector<int> state_id2index_block_;
 };
 
 ///////////////////////////////////////////////////////////////////////////
 //i////////////////// Template Implementation /////////////////////////////
 ///////////////////////////////////////////////////////////////////////////
 
+GRAPH_TEMPLATE
+constexpr int GRAPH_CLASS::kUnevaluatedCost;
+GRAPH_TEMPLATE
+constexpr int GRAPH_CLASS::kInfeasibleCost;
+
 GRAPH_TEMPLATE
 GRAPH_CLASS::BGEnvironment(const Graph &graph) : graph_(graph) {
+  CompileGraph();
+  Initialize();
+}
+
+GRAPH_TEMPLATE
+GRAPH_CLASS::BGEnvironment(Graph &&graph) : graph_(std::move(graph)) {
+  CompileGraph();
+  Initialize();
+}
+
+GRAPH_TEMPLATE
+GRAPH_CLASS::BGEnvironment(std::shared_ptr<const Graph> graph) :
+  shared_graph_(std::move(graph)), owns_graph_(false) {
+  CompileGraph();
+  Initialize();
+}
+
+GRAPH_TEMPLATE
+GRAPH_CLASS::BGEnvironment(const RoadmapFile &roadmap) : owns_graph_(false) {
+  compiled_graph_ = roadmap.ToCompiledGraph();
+  heuristics_.assign(roadmap.heuristics(),
+                     roadmap.heuristics() + roadmap.NumVertices());
+  edge_probabilities_.assign(roadmap.probabilities(),
+                             roadmap.probabilities() + roadmap.NumEdges());
+  evaluation_times_.assign(roadmap.evaluation_times(),
+                           roadmap.evaluation_times() + roadmap.NumEdges());
+  ResetEdgeEvaluations();
+  Initialize();
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::Initialize() {
   heuristic_map_ = get(&VertexType::heuristic, graph_);
   edge_cost_map_ = get(&EdgeType::cost, graph_);
 
   // Sadly, this is needed for backward compatibility with old SBPL planners.
-  for (int vertex_id = 0; vertex_id < num_vertices(graph_); ++vertex_id) {
-    int *entry = new int[NUMOFINDICES_STATEID2IND];
-    StateID2IndexMapping.push_back(entry);
-
-    for (int ii = 0; ii < NUMOFINDICES_STATEID2IND; ++ii) {
-      StateID2IndexMapping[vertex_id][ii] = -1;
-    }
+  // The entries of all vertices share one block instead of being allocated
+  // one by one.
+  const size_t num_vertices_in_graph = compiled_graph_.NumVertices();
+  state_id2index_block_.assign(num_vertices_in_graph * NUMOFINDICES_STATEID2IND,
+                               -1);
+  StateID2IndexMapping.resize(num_vertices_in_graph);
+
+  for (size_t vertex_id = 0; vertex_id < num_vertices_in_graph; ++vertex_id) {
+    StateID2IndexMapping[vertex_id] = &state_id2index_block_[vertex_id *
+                                                             NUMOFINDICES_STATEID2IND];
   }
-
 }
 
 GRAPH_TEMPLATE
 GRAPH_CLASS::~BGEnvironment() {
-  // More sadness.
-  for (auto it = StateID2IndexMapping.begin(); it != StateID2IndexMapping.end();) {
-    if (*it == nullptr) {
-      it = StateID2IndexMapping.erase(it);
-    } else {
-      ++it;
+  // More sadness: the entries point into state_id2index_block_, so they must
+  // not be deleted one by one by DiscreteSpaceInformation.
+  StateID2IndexMapping.clear();
+}
+
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::CompileGraph() {
+  const Graph &graph = this->graph();
+  compiled_graph_ = CompiledGraph::FromGraph(graph, get(&EdgeType::cost, graph));
+  heuristics_.resize(num_vertices(graph));
+  const auto index_map = get(bo::vertex_index, graph);
+  typename GraphTraits::vertex_iterator vertex_it, vertex_end;
+
+  graph_edges_.clear();
+
+  if (owns_graph_) {
+    graph_edges_.resize(compiled_graph_.NumEdges());
+  }
+
+  for (std::tie(vertex_it, vertex_end) = vertices(graph); vertex_it != vertex_end;
+       ++vertex_it) {
+    heuristics_[index_map[*vertex_it]] = graph[*vertex_it].heuristic;
+
+    if (!owns_graph_) {
+      continue;
+    }
+
+    // Edge IDs of a vertex follow the order of its out-edges.
+    size_t edge_id = compiled_graph_.EdgesBegin(index_map[*vertex_it]);
+    OutEdgeIterator out_it, out_end;
+
+    for (std::tie(out_it, out_end) = out_edges(*vertex_it, graph); out_it != out_end;
+         ++out_it) {
+      graph_edges_[edge_id++] = *out_it;
     }
   }
-}
 
+  internal::GetEdgeProperties(graph, &edge_probabilities_, &evaluation_times_);
+  InvalidateGoalHeuristics();
+  ResetEdgeEvaluations();
+}
 
 GRAPH_TEMPLATE
 void GRAPH_CLASS::GetSuccs(int parent_id, std::vector<int> *succ_ids,
                            std::vector<int> *costs) {
+  if (!edge_evaluator_) {
+    compiled_graph_.GetSuccs(parent_id, succ_ids, costs);
+    return;
+  }
+
+  std::vector<std::pair<int, size_t>> pending_edges;
+
+  for (size_t edge_id = compiled_graph_.EdgesBegin(parent_id);
+       edge_id < compiled_graph_.EdgesEnd(parent_id); ++edge_id) {
+    if (true_costs_[edge_id] == kUnevaluatedCost) {
+      pending_edges.emplace_back(parent_id, edge_id);
+    }
+  }
+
+  EvaluateEdgeBatch(pending_edges);
   succ_ids->clear();
   costs->clear();
-  IndexMap index_map = get(bo::vertex_index, graph_);
-  auto parent_vertex = bo::vertex(parent_id, graph_);
-  OutEdgeIterator out_i, out_end;
-  Edge e;
 
-  for (std::tie(out_i, out_end) = out_edges(parent_vertex, graph_);
-       out_i != out_end; ++out_i) {
-    e = *out_i;
-    // Vertex src = bo::source(e, graph_);
-    Vertex targ = bo::target(e, graph_);
-    succ_ids->push_back(index_map[targ]);
-    costs->push_back(edge_cost_map_[e]);
+  for (size_t edge_id = compiled_graph_.EdgesBegin(parent_id);
+       edge_id < compiled_graph_.EdgesEnd(parent_id); ++edge_id) {
+    const int true_cost = true_costs_[edge_id];
+
+    if (true_cost >= 0) {
+      succ_ids->push_back(compiled_graph_.targets[edge_id]);
+      costs->push_back(true_cost);
+    }
   }
 }
 
 GRAPH_TEMPLATE
 void GRAPH_CLASS::GetLazySuccs(int parent_id, std::vector<int> *succ_ids,
                                std::vector<int> *costs, std::vector<bool> *true_costs) {
-  GetSuccs(parent_id, succ_ids, costs);
-  true_costs->resize(succ_ids->size(), true);
+  if (!edge_evaluator_) {
+    GetSuccs(parent_id, succ_ids, costs);
+    true_costs->assign(succ_ids->size(), true);
+    return;
+  }
+
+  succ_ids->clear();
+  costs->clear();
+  true_costs->clear();
+
+  for (size_t edge_id = compiled_graph_.EdgesBegin(parent_id);
+       edge_id < compiled_graph_.EdgesEnd(parent_id); ++edge_id) {
+    const int true_cost = true_costs_[edge_id];
+
+    if (true_cost == kUnevaluatedCost) {
+      succ_ids->push_back(compiled_graph_.targets[edge_id]);
+      costs->push_back(compiled_graph_.costs[edge_id]);
+      true_costs->push_back(false);
+    } else if (true_cost >= 0) {
+      succ_ids->push_back(compiled_graph_.targets[edge_id]);
+      costs->push_back(true_cost);
+      true_costs->push_back(true);
+    }
+  }
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::GetPreds(int child_id, std::vector<int> *pred_ids,
+                           std::vector<int> *costs) {
+  if (!edge_evaluator_) {
+    compiled_graph_.GetPreds(child_id, pred_ids, costs);
+    return;
+  }
+
+  std::vector<std::pair<int, size_t>> pending_edges;
+
+  for (size_t in_edge = compiled_graph_.InEdgesBegin(child_id);
+       in_edge < compiled_graph_.InEdgesEnd(child_id); ++in_edge) {
+    const size_t edge_id = compiled_graph_.reverse_edge_ids[in_edge];
+
+    if (true_costs_[edge_id] == kUnevaluatedCost) {
+      pending_edges.emplace_back(compiled_graph_.sources[in_edge], edge_id);
+    }
+  }
+
+  EvaluateEdgeBatch(pending_edges);
+  pred_ids->clear();
+  costs->clear();
+
+  for (size_t in_edge = compiled_graph_.InEdgesBegin(child_id);
+       in_edge < compiled_graph_.InEdgesEnd(child_id); ++in_edge) {
+    const int true_cost = true_costs_[compiled_graph_.reverse_edge_ids[in_edge]];
+
+    if (true_cost >= 0) {
+      pred_ids->push_back(compiled_graph_.sources[in_edge]);
+      costs->push_back(true_cost);
+    }
+  }
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::GetLazyPreds(int child_id, std::vector<int> *pred_ids,
+                               std::vector<int> *costs, std::vector<bool> *true_costs) {
+  if (!edge_evaluator_) {
+    GetPreds(child_id, pred_ids, costs);
+    true_costs->assign(pred_ids->size(), true);
+    return;
+  }
+
+  pred_ids->clear();
+  costs->clear();
+  true_costs->clear();
+
+  for (size_t in_edge = compiled_graph_.InEdgesBegin(child_id);
+       in_edge < compiled_graph_.InEdgesEnd(child_id); ++in_edge) {
+    const size_t edge_id = compiled_graph_.reverse_edge_ids[in_edge];
+    const int true_cost = true_costs_[edge_id];
+
+    if (true_cost == kUnevaluatedCost) {
+      pred_ids->push_back(compiled_graph_.sources[in_edge]);
+      costs->push_back(compiled_graph_.costs[edge_id]);
+      true_costs->push_back(false);
+    } else if (true_cost >= 0) {
+      pred_ids->push_back(compiled_graph_.sources[in_edge]);
+      costs->push_back(true_cost);
+      true_costs->push_back(true);
+    }
+  }
+}
+
+GRAPH_TEMPLATE
+int GRAPH_CLASS::GetTrueCost(int parent_id, int child_id) {
+  // The cheapest of any parallel edges.
+  int best_cost = -1;
+
+  for (size_t edge_id = compiled_graph_.EdgesBegin(parent_id);
+       edge_id < compiled_graph_.EdgesEnd(parent_id); ++edge_id) {
+    if (compiled_graph_.targets[edge_id] != child_id) {
+      continue;
+    }
+
+    const int cost = edge_evaluator_ ? EvaluateEdge(parent_id, edge_id) :
+                     compiled_graph_.costs[edge_id];
+
+    if (cost >= 0 && (best_cost < 0 || cost < best_cost)) {
+      best_cost = cost;
+    }
+  }
+
+  return best_cost;
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::SetEdgeEvaluator(EdgeEvaluator edge_evaluator) {
+  edge_evaluator_ = std::move(edge_evaluator);
+  ResetEdgeEvaluations();
+}
+
+GRAPH_TEMPLATE
+int GRAPH_CLASS::EvaluateEdge(int source_id, size_t edge_id) {
+  if (true_costs_[edge_id] == kUnevaluatedCost) {
+    RunEdgeEvaluator(source_id, edge_id);
+    ++num_edge_evaluations_;
+    StoreEvaluationTime(edge_id, internal::HasEvaluationTime<EdgeType>());
+  }
+
+  return true_costs_[edge_id];
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::EvaluateEdges(const std::vector<std::pair<int, int>> &edges) {
+  if (!edge_evaluator_) {
+    return;
+  }
+
+  std::vector<std::pair<int, size_t>> pending_edges;
+
+  for (const auto &edge : edges) {
+    for (size_t edge_id = compiled_graph_.EdgesBegin(edge.first);
+         edge_id < compiled_graph_.EdgesEnd(edge.first); ++edge_id) {
+      if (compiled_graph_.targets[edge_id] == edge.second &&
+          true_costs_[edge_id] == kUnevaluatedCost) {
+        pending_edges.emplace_back(edge.first, edge_id);
+      }
+    }
+  }
+
+  // Each edge must be evaluated by a single task.
+  std::sort(pending_edges.begin(), pending_edges.end(),
+  [](const std::pair<int, size_t> &lhs, const std::pair<int, size_t> &rhs) {
+    return lhs.second < rhs.second;
+  });
+  pending_edges.erase(std::unique(pending_edges.begin(), pending_edges.end()),
+                      pending_edges.end());
+  EvaluateEdgeBatch(pending_edges);
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::EvaluateEdgeBatch(const std::vector<std::pair<int, size_t>>
+                                    &edges) {
+  if (thread_pool_) {
+    thread_pool_->ParallelFor(edges.size(), [&](size_t ii) {
+      RunEdgeEvaluator(edges[ii].first, edges[ii].second);
+    });
+  } else {
+    for (const auto &edge : edges) {
+      RunEdgeEvaluator(edge.first, edge.second);
+    }
+  }
+
+  num_edge_evaluations_ += edges.size();
+
+  for (const auto &edge : edges) {
+    StoreEvaluationTime(edge.second, internal::HasEvaluationTime<EdgeType>());
+  }
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::RunEdgeEvaluator(int source_id, size_t edge_id) {
+  const auto start = std::chrono::steady_clock::now();
+  true_costs_[edge_id] = edge_evaluator_(source_id,
+                                         compiled_graph_.targets[edge_id], edge_id);
+  evaluation_times_[edge_id] = std::chrono::duration<double>
+                               (std::chrono::steady_clock::now() - start).count();
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::StoreEvaluationTime(size_t edge_id, std::true_type) {
+  if (!owns_graph_) {
+    return;
+  }
+
+  graph_[graph_edges_[edge_id]].evaluation_time = evaluation_times_[edge_id];
+}
+
+GRAPH_TEMPLATE
+template <class EdgeUpdate>
+bool GRAPH_CLASS::ForEachEdgeBetween(int parent_id, int child_id,
+                                     EdgeUpdate update) {
+  bool found = false;
+
+  for (size_t edge_id = compiled_graph_.EdgesBegin(parent_id);
+       edge_id < compiled_graph_.EdgesEnd(parent_id); ++edge_id) {
+    if (compiled_graph_.targets[edge_id] == child_id) {
+      update(parent_id, edge_id);
+      found = true;
+    }
+  }
+
+  if (bo::is_undirected(graph()) && parent_id != child_id) {
+    for (size_t edge_id = compiled_graph_.EdgesBegin(child_id);
+         edge_id < compiled_graph_.EdgesEnd(child_id); ++edge_id) {
+      if (compiled_graph_.targets[edge_id] == parent_id) {
+        update(child_id, edge_id);
+        found = true;
+      }
+    }
+  }
+
+  if (found) {
+    InvalidateGoalHeuristics();
+    changed_state_ids_.push_back(parent_id);
+    changed_state_ids_.push_back(child_id);
+  }
+
+  return found;
+}
+
+GRAPH_TEMPLATE
+bool GRAPH_CLASS::UpdateEdgeCost(int parent_id, int child_id, int cost) {
+  if (cost < 0) {
+    std::ostringstream ss;
+    ss << "Negative cost " << cost << " for edge (" << parent_id << ", " <<
+       child_id << ")" << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  return ForEachEdgeBetween(parent_id, child_id, [&](int, size_t edge_id) {
+    compiled_graph_.SetEdgeCost(edge_id, cost);
+
+    if (owns_graph_) {
+      edge_cost_map_[graph_edges_[edge_id]] = cost;
+    }
+
+    if (edge_evaluator_) {
+      true_costs_[edge_id] = kUnevaluatedCost;
+    }
+  });
+}
+
+GRAPH_TEMPLATE
+bool GRAPH_CLASS::RemoveEdge(int parent_id, int child_id) {
+  return ForEachEdgeBetween(parent_id, child_id, [&](int, size_t edge_id) {
+    compiled_graph_.RemoveEdge(edge_id);
+
+    if (edge_evaluator_) {
+      true_costs_[edge_id] = kInfeasibleCost;
+    }
+  });
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::RemoveVertex(int state_id) {
+  std::vector<int> neighbor_ids(compiled_graph_.targets.begin() +
+                                compiled_graph_.EdgesBegin(state_id),
+                                compiled_graph_.targets.begin() + compiled_graph_.EdgesEnd(state_id));
+  neighbor_ids.insert(neighbor_ids.end(),
+                      compiled_graph_.sources.begin() + compiled_graph_.InEdgesBegin(state_id),
+                      compiled_graph_.sources.begin() + compiled_graph_.InEdgesEnd(state_id));
+  std::sort(neighbor_ids.begin(), neighbor_ids.end());
+  neighbor_ids.erase(std::unique(neighbor_ids.begin(), neighbor_ids.end()),
+                     neighbor_ids.end());
+
+  for (const int neighbor_id : neighbor_ids) {
+    RemoveEdge(state_id, neighbor_id);
+    RemoveEdge(neighbor_id, state_id);
+  }
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::UpdateHeuristic(int state_id, int heuristic) {
+  heuristic_goal_id_ = -1;
+  goal_heuristics_stale_ = false;
+  heuristics_[state_id] = heuristic;
+
+  if (owns_graph_) {
+    heuristic_map_[bo::vertex(state_id, graph_)] = heuristic;
+  }
+
+  changed_state_ids_.push_back(state_id);
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::ComputeGoalHeuristics(int goal_id) {
+  if (goal_id < 0 || static_cast<size_t>(goal_id) >= compiled_graph_.NumVertices()) {
+    std::ostringstream ss;
+    ss << "Asked for heuristics to non-existent goal state ID: " << goal_id <<
+       std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  auto cached = std::find_if(goal_heuristics_.begin(), goal_heuristics_.end(),
+  [goal_id](const std::pair<int, std::vector<int>> &entry) {
+    return entry.first == goal_id;
+  });
+  std::vector<int> computed;
+  const std::vector<int> *costs_to_go = &computed;
+
+  if (cached != goal_heuristics_.end()) {
+    std::rotate(cached, cached + 1, goal_heuristics_.end());
+    costs_to_go = &goal_heuristics_.back().second;
+  } else {
+    ComputeCostsToGo(goal_id, &computed);
+  }
+
+  for (size_t state_id = 0; state_id < heuristics_.size(); ++state_id) {
+    const int heuristic = (*costs_to_go)[state_id];
+
+    if (heuristics_[state_id] != heuristic) {
+      heuristics_[state_id] = heuristic;
+      changed_state_ids_.push_back(static_cast<int>(state_id));
+
+      if (owns_graph_) {
+        heuristic_map_[bo::vertex(state_id, graph_)] = heuristic;
+      }
+    }
+  }
+
+  heuristic_goal_id_ = goal_id;
+  goal_heuristics_stale_ = false;
+
+  if (cached == goal_heuristics_.end() && max_cached_goals_ > 0) {
+    if (goal_heuristics_.size() >= max_cached_goals_) {
+      goal_heuristics_.erase(goal_heuristics_.begin(),
+                             goal_heuristics_.end() - (max_cached_goals_ - 1));
+    }
+
+    goal_heuristics_.emplace_back(goal_id, std::move(computed));
+  }
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::SetMaxCachedGoals(size_t max_cached_goals) {
+  max_cached_goals_ = max_cached_goals;
+
+  if (goal_heuristics_.size() > max_cached_goals_) {
+    goal_heuristics_.erase(goal_heuristics_.begin(),
+                           goal_heuristics_.end() - max_cached_goals_);
+  }
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::ComputeCostsToGo(int goal_id,
+                                   std::vector<int> *costs_to_go) const {
+  // Costs are summed in 64 bits, since unset edge costs are INT_MAX.
+  typedef std::pair<int64_t, int> QueueEntry;
+  std::vector<int64_t> costs(compiled_graph_.NumVertices(),
+                             std::numeric_limits<int64_t>::max());
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>>
+      open;
+  costs[goal_id] = 0;
+  open.emplace(0, goal_id);
+
+  while (!open.empty()) {
+    const QueueEntry entry = open.top();
+    open.pop();
+
+    // Stale entry of a state that was already expanded.
+    if (entry.first > costs[entry.second]) {
+      continue;
+    }
+
+    for (size_t in_edge = compiled_graph_.InEdgesBegin(entry.second);
+         in_edge < compiled_graph_.InEdgesEnd(entry.second); ++in_edge) {
+      const size_t edge_id = compiled_graph_.reverse_edge_ids[in_edge];
+
+      if (compiled_graph_.IsRemoved(edge_id)) {
+        continue;
+      }
+
+      const int source_id = compiled_graph_.sources[in_edge];
+      const int64_t cost_to_go = entry.first + compiled_graph_.costs[edge_id];
+
+      if (cost_to_go < costs[source_id]) {
+        costs[source_id] = cost_to_go;
+        open.emplace(cost_to_go, source_id);
+      }
+    }
+  }
+
+  costs_to_go->resize(costs.size());
+
+  for (size_t state_id = 0; state_id < costs.size(); ++state_id) {
+    (*costs_to_go)[state_id] = static_cast<int>(std::min<int64_t>(costs[state_id],
+                                                                  INFINITECOST));
+  }
+}
+
+GRAPH_TEMPLATE
+void GRAPH_CLASS::GetChangedStateIDs(std::vector<int> *state_ids) {
+  if (goal_heuristics_stale_) {
+    ComputeGoalHeuristics(heuristic_goal_id_);
+  }
+
+  std::sort(changed_state_ids_.begin(), changed_state_ids_.end());
+  changed_state_ids_.erase(std::unique(changed_state_ids_.begin(),
+                                       changed_state_ids_.end()), changed_state_ids_.end());
+  state_ids->swap(changed_state_ids_);
+  changed_state_ids_.clear();
 }
 
 
 GRAPH_TEMPLATE
 int GRAPH_CLASS::GetGoalHeuristic(int state_id) {
-  return heuristic_map_[bo::vertex(state_id, graph_)];
+  if (goal_heuristics_stale_) {
+    ComputeGoalHeuristics(heuristic_goal_id_);
+  }
+
+  return heuristics_[state_id];
 }
 
 ///////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <cstddef>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include <boost/graph/graph_traits.hpp>
+#include <boost/graph/properties.hpp>
+
+namespace sbpl_utils {
+
+// Out-edges of a graph in compressed sparse row (CSR) form: the out-edges of
+// vertex v occupy positions offsets[v]..offsets[v + 1]-1 of the parallel
+// targets and costs arrays. Successor generation is then a read of two
+// contiguous spans instead of a walk over adjacency list iterators and
+// property maps.
+//
+// An edge's position in the arrays is a dense, stable edge ID (for as long
+// as the CompiledGraph is not recompiled). Undirected edges are stored once
+// per direction.
+//
+// A reverse index of the same edges, for predecessor generation, is kept in
+// the same form: the in-edges of vertex v occupy positions
+// reverse_offsets[v]..reverse_offsets[v + 1]-1 of sources and
+// reverse_edge_ids, the latter holding the edges' IDs in the forward arrays
+// (and thereby their costs).
+//
+// Edges can be removed in place, which marks their cost as kRemovedEdgeCost
+// and leaves the layout and all edge IDs unchanged. Successor and
+// predecessor generation skip removed edges.
+struct CompiledGraph {
+  // Cost of removed edges.
+  static const int kRemovedEdgeCost = -1;
+
+  std::vector<size_t> offsets;
+  std::vector<int> targets;
+  std::vector<int> costs;
+  size_t num_removed_edges = 0;
+
+  std::vector<size_t> reverse_offsets;
+  std::vector<int> sources;
+  std::vector<size_t> reverse_edge_ids;
+
+  // Compiles the out-edges of a boost graph, taking vertex IDs from its
+  // vertex index map and edge costs from cost_map. Throws error if any cost
+  // is negative, as in SetEdgeCost.
+  template <class Graph, class CostMap>
+  static CompiledGraph FromGraph(const Graph &graph, CostMap cost_map);
+
+  size_t NumVertices() const {
+    return offsets.empty() ? 0 : offsets.size() - 1;
+  }
+  size_t NumEdges() const {
+    return targets.size();
+  }
+
+  // Edge IDs of the out-edges of vertex_id are [EdgesBegin, EdgesEnd).
+  size_t EdgesBegin(int vertex_id) const {
+    return offsets[vertex_id];
+  }
+  size_t EdgesEnd(int vertex_id) const {
+    return offsets[vertex_id + 1];
+  }
+  size_t OutDegree(int vertex_id) const {
+    return EdgesEnd(vertex_id) - EdgesBegin(vertex_id);
+  }
+
+  // Positions of the in-edges of vertex_id in the reverse index are
+  // [InEdgesBegin, InEdgesEnd).
+  size_t InEdgesBegin(int vertex_id) const {
+    return reverse_offsets[vertex_id];
+  }
+  size_t InEdgesEnd(int vertex_id) const {
+    return reverse_offsets[vertex_id + 1];
+  }
+  size_t InDegree(int vertex_id) const {
+    return InEdgesEnd(vertex_id) - InEdgesBegin(vertex_id);
+  }
+
+  bool IsRemoved(size_t edge_id) const {
+    return costs[edge_id] == kRemovedEdgeCost;
+  }
+
+  // Sets the cost of an edge, restoring it if it was removed. Throws error if
+  // cost is negative, since negative costs are reserved for removed edges.
+  void SetEdgeCost(size_t edge_id, int cost) {
+    if (cost < 0) {
+      std::ostringstream ss;
+      ss << "Negative cost " << cost << " for edge " << edge_id << std::endl;
+      throw std::runtime_error(ss.str());
+    }
+
+    if (IsRemoved(edge_id)) {
+      --num_removed_edges;
+    }
+
+    costs[edge_id] = cost;
+  }
+
+  void RemoveEdge(size_t edge_id) {
+    if (!IsRemoved(edge_id)) {
+      costs[edge_id] = kRemovedEdgeCost;
+      ++num_removed_edges;
+    }
+  }
+
+  // Replaces succ_ids and costs with the out-edges of vertex_id.
+  void GetSuccs(int vertex_id, std::vector<int> *succ_ids,
+                std::vector<int> *succ_costs) const {
+    if (num_removed_edges > 0) {
+      succ_ids->clear();
+      succ_costs->clear();
+
+      for (size_t edge_id = EdgesBegin(vertex_id); edge_id < EdgesEnd(vertex_id);
+           ++edge_id) {
+        if (!IsRemoved(edge_id)) {
+          succ_ids->push_back(targets[edge_id]);
+          succ_costs->push_back(costs[edge_id]);
+        }
+      }
+
+      return;
+    }
+
+    // Ranges of trivially copyable values, so these are plain block copies.
+    succ_ids->assign(targets.data() + EdgesBegin(vertex_id),
+                     targets.data() + EdgesEnd(vertex_id));
+    succ_costs->assign(costs.data() + EdgesBegin(vertex_id),
+                       costs.data() + EdgesEnd(vertex_id));
+  }
+
+  // Replaces pred_ids and costs with the in-edges of vertex_id.
+  void GetPreds(int vertex_id, std::vector<int> *pred_ids,
+                std::vector<int> *pred_costs) const {
+    if (num_removed_edges > 0) {
+      pred_ids->clear();
+      pred_costs->clear();
+
+      for (size_t in_edge = InEdgesBegin(vertex_id); in_edge < InEdgesEnd(vertex_id);
+           ++in_edge) {
+        if (!IsRemoved(reverse_edge_ids[in_edge])) {
+          pred_ids->push_back(sources[in_edge]);
+          pred_costs->push_back(costs[reverse_edge_ids[in_edge]]);
+        }
+      }
+
+      return;
+    }
+
+    pred_ids->assign(sources.data() + InEdgesBegin(vertex_id),
+                     sources.data() + InEdgesEnd(vertex_id));
+    pred_costs->resize(pred_ids->size());
+
+    for (size_t ii = 0; ii < pred_ids->size(); ++ii) {
+      (*pred_costs)[ii] = costs[reverse_edge_ids[InEdgesBegin(vertex_id) + ii]];
+    }
+  }
+
+  // Builds the reverse index from the forward arrays.
+  void BuildReverseIndex();
+};
+
+inline void CompiledGraph::BuildReverseIndex() {
+  const size_t num_vertices = NumVertices();
+  reverse_offsets.assign(num_vertices + 1, 0);
+
+  for (const int target : targets) {
+    ++reverse_offsets[target + 1];
+  }
+
+  for (size_t ii = 0; ii < num_vertices; ++ii) {
+    reverse_offsets[ii + 1] += reverse_offsets[ii];
+  }
+
+  // Counting sort by target, keeping the forward order within each vertex.
+  std::vector<size_t> next_in_edge(reverse_offsets.begin(),
+                                   reverse_offsets.end() - 1);
+  sources.resize(targets.size());
+  reverse_edge_ids.resize(targets.size());
+
+  for (size_t source = 0; source < num_vertices; ++source) {
+    for (size_t edge_id = offsets[source]; edge_id < offsets[source + 1];
+         ++edge_id) {
+      const size_t in_edge = next_in_edge[targets[edge_id]]++;
+      sources[in_edge] = static_cast<int>(source);
+      reverse_edge_ids[in_edge] = edge_id;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Template Inline Implementation
+///////////////////////////////////////////////////////////////////////////////
+
+template <class Graph, class CostMap>
+CompiledGraph CompiledGraph::FromGraph(const Graph &graph, CostMap cost_map) {
+  typedef boost::graph_traits<Graph> GraphTraits;
+  const auto index_map = get(boost::vertex_index, graph);
+  const size_t num_vertices_in_graph = num_vertices(graph);
+
+  CompiledGraph compiled;
+  compiled.offsets.assign(num_vertices_in_graph + 1, 0);
+
+  // Vertices may be iterated in any order, so count degrees first.
+  typename GraphTraits::vertex_iterator vertex_it, vertex_end;
+
+  for (std::tie(vertex_it, vertex_end) = vertices(graph); vertex_it != vertex_end;
+       ++vertex_it) {
+    compiled.offsets[index_map[*vertex_it] + 1] = out_degree(*vertex_it, graph);
+  }
+
+  for (size_t ii = 0; ii < num_vertices_in_graph; ++ii) {
+    compiled.offsets[ii + 1] += compiled.offsets[ii];
+  }
+
+  compiled.targets.resize(compiled.offsets.back());
+  compiled.costs.resize(compiled.offsets.back());
+
+  for (std::tie(vertex_it, vertex_end) = vertices(graph); vertex_it != vertex_end;
+       ++vertex_it) {
+    size_t edge_id = compiled.offsets[index_map[*vertex_it]];
+    typename GraphTraits::out_edge_iterator out_it, out_end;
+
+    for (std::tie(out_it, out_end) = out_edges(*vertex_it, graph);
+         out_it != out_end; ++out_it, ++edge_id) {
+      compiled.targets[edge_id] = static_cast<int>(index_map[target(*out_it,
+                                                                    graph)]);
+      compiled.costs[edge_id] = cost_map[*out_it];
+
+      if (compiled.costs[edge_id] < 0) {
+        std::ostringstream ss;
+        ss << "Negative cost " << compiled.costs[edge_id] << " for edge (" <<
+           index_map[*vertex_it] << ", " << compiled.targets[edge_id] << ")" <<
+           std::endl;
+        throw std::runtime_error(ss.str());
+      }
+    }
+  }
+
+  compiled.BuildReverseIndex();
+  return compiled;
+}
+}  // namespace sbpl_utils
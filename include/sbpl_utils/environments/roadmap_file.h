@@ -0,0 +1,229 @@
+#pragma once
+
+#include <sbpl_utils/common/mapped_file.h>
+#include <sbpl_utils/environments/compiled_graph.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/graph/graph_traits.hpp>
+#include <boost/graph/properties.hpp>
+
+namespace sbpl_utils {
+
+// Binary roadmap file, from which a BGEnvironment can be constructed without
+// building a boost graph first (see WriteRoadmap and ImportEdgeList).
+//
+// The file holds a header followed by the roadmap in CSR form, as in
+// CompiledGraph: the vertex heuristics, the out-edge offsets of every vertex,
+// and the targets, costs, probabilities and evaluation times of the edges
+// (the members of EdgeWithCostAndProbability). Undirected edges are stored
+// once per direction. Every array is aligned so that the file can be
+// memory-mapped and read in place. Roadmaps use the writer's byte order.
+struct RoadmapHeader {
+  static constexpr uint32_t kVersion = 1;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t num_vertices;
+  uint64_t num_edges;
+  uint64_t heuristics_offset;
+  uint64_t offsets_offset;
+  uint64_t targets_offset;
+  uint64_t costs_offset;
+  uint64_t probabilities_offset;
+  uint64_t evaluation_times_offset;
+};
+
+// Read-only view of a roadmap file. The file is memory-mapped, so opening a
+// roadmap costs the same regardless of its size, and the arrays below are
+// read in place. A BGEnvironment constructed from it copies the arrays
+// (costs and heuristics are per-environment and may be updated) and builds
+// the reverse index, so the file need not outlive the environment.
+class RoadmapFile {
+ public:
+  // Throws error if the file cannot be mapped or is not a roadmap.
+  explicit RoadmapFile(const std::string &path);
+
+  size_t NumVertices() const {
+    return static_cast<size_t>(header_->num_vertices);
+  }
+  size_t NumEdges() const {
+    return static_cast<size_t>(header_->num_edges);
+  }
+
+  // Arrays of NumVertices() heuristics, NumVertices() + 1 offsets, and
+  // NumEdges() of the rest.
+  const int32_t *heuristics() const {
+    return heuristics_;
+  }
+  const uint64_t *offsets() const {
+    return offsets_;
+  }
+  const int32_t *targets() const {
+    return targets_;
+  }
+  const int32_t *costs() const {
+    return costs_;
+  }
+  const double *probabilities() const {
+    return probabilities_;
+  }
+  const double *evaluation_times() const {
+    return evaluation_times_;
+  }
+
+  // Copies the edges into a CompiledGraph, with its reverse index. Throws
+  // error if the offsets or targets are out of range or a cost is negative.
+  CompiledGraph ToCompiledGraph() const;
+
+ private:
+  MappedFile file_;
+  const RoadmapHeader *header_;
+  const int32_t *heuristics_;
+  const uint64_t *offsets_;
+  const int32_t *targets_;
+  const int32_t *costs_;
+  const double *probabilities_;
+  const double *evaluation_times_;
+};
+
+// Writes a compiled graph to a roadmap file. Empty probabilities and
+// evaluation times are written as 1 and 0. Throws error on I/O failure or if
+// any edge cost is negative (including removed edges).
+void WriteRoadmap(const std::string &path, const CompiledGraph &graph,
+                  const std::vector<int> &heuristics,
+                  const std::vector<double> &probabilities = std::vector<double>(),
+                  const std::vector<double> &evaluation_times = std::vector<double>());
+
+// Writes a boost graph with bundled properties, as used by BGEnvironment, to
+// a roadmap file. Edge probabilities and evaluation times are taken from the
+// edge bundles if they have them.
+template <class Graph>
+void WriteRoadmap(const std::string &path, const Graph &graph);
+
+// Converts an edge list in text form to a roadmap file, streaming it in two
+// passes without holding more than the roadmap's arrays in memory. Each line
+// of the text is one of
+//
+// v <vertex ID> <heuristic>
+// e <from ID> <to ID> <cost> [<probability> [<evaluation time>]]
+//
+// or a comment starting with #. Vertex IDs run from 0 to the largest ID in
+// the text, and vertices without a "v" line have heuristic 0. If undirected
+// is set, every edge is stored in both directions. Throws error, with the line
+// number, if the text cannot be read or parsed, or if an ID, cost or
+// heuristic does not fit in 32 bits or a cost is negative.
+void ImportEdgeList(const std::string &text_path,
+                    const std::string &roadmap_path, bool undirected = false);
+
+namespace internal {
+// Whether edge bundles of type T have an evaluation_time member.
+template <typename T, typename = void>
+struct HasEvaluationTime : std::false_type {};
+template <typename T>
+struct HasEvaluationTime<T, decltype(void(std::declval<T &>().evaluation_time))> :
+  std::true_type {};
+
+// Whether edge bundles of type T have a probability member.
+template <typename T, typename = void>
+struct HasProbability : std::false_type {};
+template <typename T>
+struct HasProbability<T, decltype(void(std::declval<T &>().probability))> :
+  std::true_type {};
+
+template <class EdgeType>
+void AppendProbability(const EdgeType &edge, std::vector<double> *probabilities,
+                       std::true_type) {
+  probabilities->push_back(edge.probability);
+}
+template <class EdgeType>
+void AppendProbability(const EdgeType &, std::vector<double> *, std::false_type) {}
+
+template <class EdgeType>
+void AppendEvaluationTime(const EdgeType &edge,
+                          std::vector<double> *evaluation_times, std::true_type) {
+  evaluation_times->push_back(edge.evaluation_time);
+}
+template <class EdgeType>
+void AppendEvaluationTime(const EdgeType &, std::vector<double> *,
+                          std::false_type) {}
+
+// Replaces probabilities and evaluation_times with those of the edges of
+// graph in CompiledGraph edge ID order, or with nothing if the edge bundles
+// do not have them.
+template <class Graph>
+void GetEdgeProperties(const Graph &graph, std::vector<double> *probabilities,
+                       std::vector<double> *evaluation_times);
+}  // namespace internal
+
+///////////////////////////////////////////////////////////////////////////////
+// Template Inline Implementation
+///////////////////////////////////////////////////////////////////////////////
+
+template <class Graph>
+void internal::GetEdgeProperties(const Graph &graph,
+                                 std::vector<double> *probabilities,
+                                 std::vector<double> *evaluation_times) {
+  typedef boost::graph_traits<Graph> GraphTraits;
+  typedef typename boost::edge_bundle_type<Graph>::type EdgeType;
+
+  const auto index_map = get(boost::vertex_index, graph);
+  std::vector<std::pair<size_t, typename GraphTraits::vertex_descriptor>>
+  vertices_by_id;
+  typename GraphTraits::vertex_iterator vertex_it, vertex_end;
+
+  for (std::tie(vertex_it, vertex_end) = vertices(graph); vertex_it != vertex_end;
+       ++vertex_it) {
+    vertices_by_id.emplace_back(index_map[*vertex_it], *vertex_it);
+  }
+
+  // Edge IDs are ordered by source ID, then in out-edge order.
+  std::sort(vertices_by_id.begin(), vertices_by_id.end(),
+            [](const std::pair<size_t, typename GraphTraits::vertex_descriptor> &lhs,
+  const std::pair<size_t, typename GraphTraits::vertex_descriptor> &rhs) {
+    return lhs.first < rhs.first;
+  });
+  probabilities->clear();
+  evaluation_times->clear();
+
+  for (const auto &vertex : vertices_by_id) {
+    typename GraphTraits::out_edge_iterator out_it, out_end;
+
+    for (std::tie(out_it, out_end) = out_edges(vertex.second, graph);
+         out_it != out_end; ++out_it) {
+      AppendProbability(graph[*out_it], probabilities,
+                        HasProbability<EdgeType>());
+      AppendEvaluationTime(graph[*out_it], evaluation_times,
+                           HasEvaluationTime<EdgeType>());
+    }
+  }
+}
+
+template <class Graph>
+void WriteRoadmap(const std::string &path, const Graph &graph) {
+  typedef typename boost::edge_bundle_type<Graph>::type EdgeType;
+
+  const CompiledGraph compiled = CompiledGraph::FromGraph(graph,
+                                                          get(&EdgeType::cost, graph));
+  const auto index_map = get(boost::vertex_index, graph);
+  std::vector<int> heuristics(compiled.NumVertices());
+  typename boost::graph_traits<Graph>::vertex_iterator vertex_it, vertex_end;
+
+  for (std::tie(vertex_it, vertex_end) = vertices(graph); vertex_it != vertex_end;
+       ++vertex_it) {
+    heuristics[index_map[*vertex_it]] = graph[*vertex_it].heuristic;
+  }
+
+  std::vector<double> probabilities, evaluation_times;
+  internal::GetEdgeProperties(graph, &probabilities, &evaluation_times);
+  WriteRoadmap(path, compiled, heuristics, probabilities, evaluation_times);
+}
+}  // namespace sbpl_utils
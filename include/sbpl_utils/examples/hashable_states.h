@@ -1,7 +1,17 @@
 #pragma once
 
+#include <sbpl_utils/hash_manager/hash_utils.h>
+#include <sbpl_utils/hash_manager/lattice_coordinates.h>
+
+#include <array>
 #include <cstddef>
+#include <cstring>
+#include <initializer_list>
 #include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 namespace sbpl_utils {
@@ -30,6 +40,14 @@ class StateXY {
 // Optionally implement the ostream<< operator to see useful debug results when using the hash manager.
 std::ostream &operator<< (std::ostream &stream, const StateXY &state);
 
+template <>
+struct LatticeCoordinates<StateXY> {
+  static constexpr size_t kDimensions = 2;
+  static std::array<int, kDimensions> Get(const StateXY &state) {
+    return {{state.x(), state.y()}};
+  }
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // StateXYTheta
 ///////////////////////////////////////////////////////////////////////////////
@@ -58,6 +76,14 @@ class StateXYTheta {
 // Optionally implement the ostream<< operator to see useful debug results when using the hash manager.
 std::ostream &operator<< (std::ostream &stream, const StateXYTheta &state);
 
+template <>
+struct LatticeCoordinates<StateXYTheta> {
+  static constexpr size_t kDimensions = 3;
+  static std::array<int, kDimensions> Get(const StateXYTheta &state) {
+    return {{state.x(), state.y(), state.theta()}};
+  }
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // StateDiscVector
 ///////////////////////////////////////////////////////////////////////////////
@@ -74,4 +100,86 @@ class StateDiscVector {
  private:
   std::vector<int> coords_;
 };
+
+///////////////////////////////////////////////////////////////////////////////
+// StateDiscArray
+///////////////////////////////////////////////////////////////////////////////
+
+// Fixed-dimension alternative to StateDiscVector. Coordinates are stored
+// inline, so creating a state never allocates, and a narrow coordinate type
+// (e.g. StateDiscArray<7, int16_t> for a 7-DOF arm lattice) shrinks the state
+// further. States are compared with memcmp and hashed as packed bytes.
+template <size_t N, typename T = int>
+class StateDiscArray {
+  static_assert(std::is_integral<T>::value,
+                "StateDiscArray coordinates must be integral");
+
+ public:
+  StateDiscArray() {
+    coords_.fill(0);
+  }
+  explicit StateDiscArray(const std::array<T, N> &coords) : coords_(coords) {}
+  // Drop-in for StateDiscVector. Throw error if coords does not have N
+  // entries or a coordinate does not fit in T.
+  StateDiscArray(std::initializer_list<int> coords) {
+    Assign(coords.begin(), coords.size());
+  }
+  StateDiscArray(const std::vector<int> &coords) {
+    Assign(coords.data(), coords.size());
+  }
+  const std::array<T, N> &coords() const {
+    return coords_;
+  }
+  bool operator==(const StateDiscArray &other) const {
+    return std::memcmp(coords_.data(), other.coords_.data(), sizeof(coords_)) == 0;
+  }
+  size_t GetHash() const {
+    return HashBytes(coords_.data(), sizeof(coords_));
+  }
+ private:
+  void Assign(const int *coords, size_t num_coords);
+
+  std::array<T, N> coords_;
+};
+
+template <size_t N, typename T>
+void StateDiscArray<N, T>::Assign(const int *coords, size_t num_coords) {
+  if (num_coords != N) {
+    std::ostringstream ss;
+    ss << "StateDiscArray of dimension " << N << " constructed from " <<
+       num_coords << " coordinates" << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  for (size_t ii = 0; ii < N; ++ii) {
+    const long long coord = coords[ii];
+
+    if ((coord < 0 &&
+         coord < static_cast<long long>(std::numeric_limits<T>::min())) ||
+        (coord > 0 && static_cast<unsigned long long>(coord) >
+         static_cast<unsigned long long>(std::numeric_limits<T>::max()))) {
+      std::ostringstream ss;
+      ss << "StateDiscArray coordinate " << coord << " out of range [" <<
+         static_cast<long long>(std::numeric_limits<T>::min()) << ", " <<
+         static_cast<unsigned long long>(std::numeric_limits<T>::max()) << "]" <<
+         std::endl;
+      throw std::runtime_error(ss.str());
+    }
+
+    coords_[ii] = static_cast<T>(coord);
+  }
+}
+
+template <size_t N, typename T>
+std::ostream &operator<< (std::ostream &stream,
+                          const StateDiscArray<N, T> &state) {
+  stream << "(";
+
+  for (size_t ii = 0; ii < N; ++ii) {
+    stream << (ii == 0 ? "" : ", ") << static_cast<long long>(state.coords()[ii]);
+  }
+
+  stream << ")";
+  return stream;
+}
 }  // namespace sbpl_utils
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <sbpl_utils/hash_manager/hash_manager.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace sbpl_utils {
+
+// A thread-safe counterpart of HashManager, for generating and hashing
+// successors from several threads at once (e.g. parallel A* or parallel edge
+// evaluation). HashableState has to satisfy the same contract as for
+// HashManager:
+//      size_t GetHash() const;
+//      bool operator==(const HashableState& other_state) const;
+//
+// The hash index is split into shards selected by the state's hash, each
+// protected by its own mutex, so threads only contend when they insert or
+// look up states that land in the same shard. State IDs are allocated densely
+// from a single atomic counter. States are stored in an ID-addressed array of
+// geometrically growing segments that are never moved, and each state is
+// published with a release store once constructed: GetState() on a published
+// ID is wait-free and never takes a lock.
+//
+// Reset() is the only method that must not run concurrently with others.
+template<class HashableState, class StateIndex = FlatStateIndex>
+class ConcurrentHashManager {
+ public:
+  explicit ConcurrentHashManager(size_t num_shards = 64);
+  ~ConcurrentHashManager();
+
+  ConcurrentHashManager(const ConcurrentHashManager &) = delete;
+  ConcurrentHashManager &operator=(const ConcurrentHashManager &) = delete;
+
+  // Return the number of published states.
+  size_t Size() const;
+
+  bool Exists(const HashableState &hashable_state) const;
+  // Wait-free.
+  bool Exists(unsigned int state_id) const;
+
+  // Wait-free. Throws error if the state ID has not been published.
+  const HashableState &GetState(unsigned int state_id) const;
+
+  // Throws error if state does not exist.
+  unsigned int GetStateID(const HashableState &hashable_state) const;
+
+  // Adds a new entry to hash table if one does not exist and returns the state ID.
+  // If state already exists, returns existing state ID. Concurrent calls with
+  // equal states return the same ID. The state is copied before its ID is
+  // reserved, so a throwing copy leaves no gap in the IDs. (Should moving the
+  // copy into place or allocating storage throw, the reserved ID is never
+  // published and reads as non-existent.)
+  unsigned int GetStateIDForceful(const HashableState &hashable_state);
+
+  // Clear the hash manager. Not thread-safe.
+  void Reset();
+
+ private:
+  static constexpr unsigned int kFirstSegmentBits = 10;
+  static constexpr uint64_t kFirstSegmentSize = uint64_t(1) << kFirstSegmentBits;
+  // Segment s holds kFirstSegmentSize * 2^s states, enough for all 2^32 IDs.
+  static constexpr unsigned int kNumSegments = 32 - kFirstSegmentBits + 1;
+
+  struct Slot {
+    typename std::aligned_storage<sizeof(HashableState),
+             alignof(HashableState)>::type storage;
+    std::atomic<bool> published;
+
+    const HashableState *State() const {
+      return reinterpret_cast<const HashableState *>(&storage);
+    }
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    StateIndex index;
+    // Keep neighbouring shards' mutexes off the same cache line.
+    char padding[64];
+  };
+
+  static unsigned int SegmentOf(uint64_t state_id, uint64_t *offset) {
+    const uint64_t k = state_id / kFirstSegmentSize + 1;
+    const unsigned int segment = 63 - __builtin_clzll(k);
+    *offset = state_id - kFirstSegmentSize * ((uint64_t(1) << segment) - 1);
+    return segment;
+  }
+  static uint64_t SegmentSize(unsigned int segment) {
+    return kFirstSegmentSize << segment;
+  }
+
+  // Spread the hash so that shard selection and the in-shard index use
+  // different bits.
+  Shard &ShardFor(size_t hash) const {
+    return shards_[(static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull >> 32) %
+                   num_shards_];
+  }
+
+  // Returns the slot for state_id, allocating its segment if needed.
+  Slot &SlotForInsert(unsigned int state_id);
+  // Returns nullptr if the slot's segment has not been allocated yet.
+  const Slot *FindSlot(unsigned int state_id) const;
+  const HashableState *FindPublished(unsigned int state_id) const;
+
+  unsigned int FindInShard(const Shard &shard, const HashableState &hashable_state,
+                           size_t hash) const;
+
+  const size_t num_shards_;
+  std::unique_ptr<Shard[]> shards_;
+  std::atomic<Slot *> segments_[kNumSegments];
+  std::atomic<unsigned int> next_state_id_;
+  std::atomic<size_t> size_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Template Inline Implementation
+///////////////////////////////////////////////////////////////////////////////
+
+template<class HashableState, class StateIndex>
+ConcurrentHashManager<HashableState, StateIndex>::ConcurrentHashManager(
+  size_t num_shards) : num_shards_(num_shards > 0 ? num_shards : 1),
+  shards_(new Shard[num_shards_]), next_state_id_(0), size_(0) {
+  for (auto &segment : segments_) {
+    segment.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+template<class HashableState, class StateIndex>
+ConcurrentHashManager<HashableState, StateIndex>::~ConcurrentHashManager() {
+  Reset();
+}
+
+template<class HashableState, class StateIndex>
+size_t ConcurrentHashManager<HashableState, StateIndex>::Size() const {
+  return size_.load(std::memory_order_acquire);
+}
+
+template<class HashableState, class StateIndex>
+typename ConcurrentHashManager<HashableState, StateIndex>::Slot &
+ConcurrentHashManager<HashableState, StateIndex>::SlotForInsert(
+  unsigned int state_id) {
+  uint64_t offset = 0;
+  const unsigned int segment = SegmentOf(state_id, &offset);
+  Slot *slots = segments_[segment].load(std::memory_order_acquire);
+
+  if (slots == nullptr) {
+    // Several threads may race to allocate the same segment; only one wins.
+    Slot *new_slots = new Slot[SegmentSize(segment)]();
+
+    if (segments_[segment].compare_exchange_strong(slots, new_slots,
+                                                   std::memory_order_acq_rel)) {
+      slots = new_slots;
+    } else {
+      delete[] new_slots;
+    }
+  }
+
+  return slots[offset];
+}
+
+template<class HashableState, class StateIndex>
+const typename ConcurrentHashManager<HashableState, StateIndex>::Slot *
+ConcurrentHashManager<HashableState, StateIndex>::FindSlot(
+  unsigned int state_id) const {
+  uint64_t offset = 0;
+  const unsigned int segment = SegmentOf(state_id, &offset);
+  const Slot *slots = segments_[segment].load(std::memory_order_acquire);
+  return slots == nullptr ? nullptr : &slots[offset];
+}
+
+template<class HashableState, class StateIndex>
+const HashableState *
+ConcurrentHashManager<HashableState, StateIndex>::FindPublished(
+  unsigned int state_id) const {
+  const Slot *slot = FindSlot(state_id);
+
+  if (slot == nullptr || !slot->published.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+
+  return slot->State();
+}
+
+template<class HashableState, class StateIndex>
+unsigned int ConcurrentHashManager<HashableState, StateIndex>::FindInShard(
+  const Shard &shard, const HashableState &hashable_state, size_t hash) const {
+  // IDs only enter a shard's index after their state was published, and the
+  // caller holds the shard's lock.
+  return shard.index.Find(hash, [&](unsigned int state_id) {
+    return *FindSlot(state_id)->State() == hashable_state;
+  });
+}
+
+template<class HashableState, class StateIndex>
+bool ConcurrentHashManager<HashableState, StateIndex>::Exists(
+  const HashableState &hashable_state) const {
+  const size_t hash = hashable_state.GetHash();
+  Shard &shard = ShardFor(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return FindInShard(shard, hashable_state, hash) != kInvalidStateID;
+}
+
+template<class HashableState, class StateIndex>
+bool ConcurrentHashManager<HashableState, StateIndex>::Exists(
+  unsigned int state_id) const {
+  return FindPublished(state_id) != nullptr;
+}
+
+template<class HashableState, class StateIndex>
+const HashableState &ConcurrentHashManager<HashableState, StateIndex>::GetState(
+  unsigned int state_id) const {
+  const HashableState *hashable_state = FindPublished(state_id);
+
+  if (hashable_state == nullptr) {
+    std::ostringstream ss;
+    ss << "Asked for non-existent state ID: " << state_id << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  return *hashable_state;
+}
+
+template<class HashableState, class StateIndex>
+unsigned int ConcurrentHashManager<HashableState, StateIndex>::GetStateID(
+  const HashableState &hashable_state) const {
+  const size_t hash = hashable_state.GetHash();
+  Shard &shard = ShardFor(hash);
+  unsigned int state_id = kInvalidStateID;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    state_id = FindInShard(shard, hashable_state, hash);
+  }
+
+  if (state_id == kInvalidStateID) {
+    std::ostringstream ss;
+    ss << "Asked for non-existent state: " << std::endl << hashable_state <<
+       std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  return state_id;
+}
+
+template<class HashableState, class StateIndex>
+unsigned int
+ConcurrentHashManager<HashableState, StateIndex>::GetStateIDForceful(
+  const HashableState &hashable_state) {
+  const size_t hash = hashable_state.GetHash();
+  Shard &shard = ShardFor(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  const unsigned int existing_state_id = FindInShard(shard, hashable_state,
+                                                     hash);
+
+  if (existing_state_id != kInvalidStateID) {
+    return existing_state_id;
+  }
+
+  HashableState new_state(hashable_state);
+  const unsigned int new_state_id = next_state_id_.fetch_add(1,
+                                                             std::memory_order_relaxed);
+  Slot &slot = SlotForInsert(new_state_id);
+  new (&slot.storage) HashableState(std::move(new_state));
+  slot.published.store(true, std::memory_order_release);
+  size_.fetch_add(1, std::memory_order_acq_rel);
+
+  shard.index.Insert(hash, new_state_id);
+  return new_state_id;
+}
+
+template<class HashableState, class StateIndex>
+void ConcurrentHashManager<HashableState, StateIndex>::Reset() {
+  for (unsigned int segment = 0; segment < kNumSegments; ++segment) {
+    Slot *slots = segments_[segment].exchange(nullptr);
+
+    if (slots == nullptr) {
+      continue;
+    }
+
+    for (uint64_t offset = 0; offset < SegmentSize(segment); ++offset) {
+      if (slots[offset].published.load(std::memory_order_relaxed)) {
+        slots[offset].State()->~HashableState();
+      }
+    }
+
+    delete[] slots;
+  }
+
+  for (size_t shard = 0; shard < num_shards_; ++shard) {
+    shards_[shard].index.Clear();
+  }
+
+  next_state_id_.store(0);
+  size_.store(0);
+}
+}  // namespace sbpl_utils
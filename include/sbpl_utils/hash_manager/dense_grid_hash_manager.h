@@ -0,0 +1,466 @@
+#pragma once
+
+#include <sbpl_utils/hash_manager/hash_manager.h>
+#include <sbpl_utils/hash_manager/lattice_coordinates.h>
+#include <sbpl_utils/hash_manager/state_store.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sbpl_utils {
+// A drop-in alternative to HashManager for states on a bounded discrete
+// lattice, e.g. StateXY or StateXYTheta on a map of known size. A state's
+// coordinates (see LatticeCoordinates) are mapped to a cell of a direct-index
+// table that holds the state's ID, so duplicate detection is a single array
+// access: GetHash() is never called and there are no collisions to resolve.
+//
+// The table is split into pages of 4096 cells that are only allocated once a
+// state in them is inserted, so a search that touches a small part of a large
+// lattice only pays for the pages it visits. The directory of pages is
+// allocated up front though, at one pointer per page of the whole lattice
+// (e.g. 2 MB for 2^30 cells), so lattices should be bounded tightly.
+//
+//      DenseGridHashManager<StateXYTheta> hash_manager({{0, 0, 0}},
+//                                                      {{width - 1, height - 1, 15}});
+//
+// Bounds are inclusive. Inserting a state outside them throws.
+template<class HashableState>
+class DenseGridHashManager {
+ public:
+  static constexpr size_t kDimensions =
+    LatticeCoordinates<HashableState>::kDimensions;
+  typedef std::array<int, kDimensions> Coordinates;
+
+  // Throws error if the bounds are empty in some dimension, or if the lattice
+  // has too many cells for its page directory to be allocated.
+  DenseGridHashManager(const Coordinates &min_coords,
+                       const Coordinates &max_coords);
+
+  // Return the number of states in the hash manager.
+  size_t Size() const;
+
+  // Print all states stored by the hash manager.
+  void Print() const;
+  // Print at most max_states states.
+  void Print(std::ostream &stream, size_t max_states) const;
+
+  // Whether the state's coordinates lie within the lattice bounds.
+  bool InBounds(const HashableState &hashable_state) const;
+
+  bool Exists(const HashableState &hashable_state) const;
+  bool Exists(unsigned int state_id) const;
+
+  // Throws error if state does not exist.
+  const HashableState &GetState(unsigned int state_id) const;
+
+  // Throws error if state does not exist.
+  unsigned int GetStateID(const HashableState &hashable_state) const;
+
+  // Lattice coordinates of the state with the given ID. Throws error if state
+  // does not exist.
+  Coordinates GetCoordinates(unsigned int state_id) const;
+
+  // Adds a new entry if one does not exist and returns the state ID. If state
+  // already exists, returns existing state ID. Throws error if the state is
+  // out of bounds.
+  unsigned int GetStateIDForceful(const HashableState &hashable_state);
+  unsigned int GetStateIDForceful(HashableState &&hashable_state);
+
+  // Constructs the state from args and interns it like GetStateIDForceful.
+  template<typename... Args>
+  unsigned int EmplaceState(Args &&... args);
+
+  // Batch version of GetStateIDForceful: state_ids[i] is set to the ID of
+  // hashable_states[i].
+  void GetStateIDsForceful(const HashableState *hashable_states,
+                           size_t num_states, unsigned int *state_ids);
+  void GetStateIDsForceful(const std::vector<HashableState> &hashable_states,
+                           std::vector<unsigned int> *state_ids);
+
+  // If state does not already exist, run time error is thrown. Preserves the
+  // old state ID.
+  void UpdateState(const HashableState &hashable_state);
+  void UpdateState(HashableState &&hashable_state);
+
+  // Invokes fn(HashableState &) on the stored state with the given ID. fn must
+  // not change the state's lattice coordinates. Throws if the state ID does
+  // not exist.
+  template<typename Function>
+  void ModifyState(unsigned int state_id, Function fn);
+
+  // Insert a state with a known state ID. This will throw if the state is out
+  // of bounds, or if the hashable_state or the state ID is already present.
+  void InsertState(const HashableState &hashable_state, int state_id);
+
+  // Clear the hash manager and release all pages.
+  void Reset();
+
+  // Iterable view over all (state, state ID) pairs, with the lookups of
+  // HashManager::GetStateMappings().
+  StateMappings<HashableState> GetStateMappings() const {
+    return StateMappings<HashableState>(states_,
+    [this](const HashableState & hashable_state) {
+      return FindStateID(hashable_state);
+    });
+  }
+
+  const Coordinates &min_coords() const {
+    return min_coords_;
+  }
+  const Coordinates &max_coords() const {
+    return max_coords_;
+  }
+
+  // Number of pages of the direct-index table allocated so far.
+  size_t NumAllocatedPages() const {
+    return num_allocated_pages_;
+  }
+
+ private:
+  static constexpr unsigned int kPageBits = 12;
+  static constexpr uint64_t kPageSize = uint64_t(1) << kPageBits;
+  static constexpr uint64_t kPageMask = kPageSize - 1;
+
+  // Row-major index of the state's cell; returns false if it is out of bounds.
+  bool CellIndex(const HashableState &hashable_state, uint64_t *cell) const;
+  // Like CellIndex, but throws for states that are out of bounds.
+  uint64_t CellIndexForInsert(const HashableState &hashable_state) const;
+
+  // ID stored in the cell, or kInvalidStateID.
+  unsigned int CellStateID(uint64_t cell) const;
+  // Reference to the cell's entry, allocating its page if needed.
+  unsigned int &CellForInsert(uint64_t cell);
+
+  unsigned int FindStateID(const HashableState &hashable_state) const;
+  // Throws for UpdateState calls on states that do not exist.
+  unsigned int GetStateIDForUpdate(const HashableState &hashable_state) const;
+
+  Coordinates min_coords_;
+  Coordinates max_coords_;
+  std::array<uint64_t, kDimensions> strides_;
+  // Pages of state IDs indexed by cell, or nullptr if not allocated yet.
+  std::vector<std::unique_ptr<unsigned int[]>> pages_;
+  size_t num_allocated_pages_ = 0;
+  StateStore<HashableState> states_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Template Inline Implementation
+///////////////////////////////////////////////////////////////////////////////
+
+template<class HashableState>
+DenseGridHashManager<HashableState>::DenseGridHashManager(
+  const Coordinates &min_coords, const Coordinates &max_coords) :
+  min_coords_(min_coords), max_coords_(max_coords) {
+  uint64_t num_cells = 1;
+
+  for (size_t dim = kDimensions; dim-- > 0;) {
+    if (max_coords_[dim] < min_coords_[dim]) {
+      std::ostringstream ss;
+      ss << "Lattice bounds are empty in dimension " << dim << ": [" <<
+         min_coords_[dim] << ", " << max_coords_[dim] << "]" << std::endl;
+      throw std::runtime_error(ss.str());
+    }
+
+    const uint64_t extent = static_cast<uint64_t>(static_cast<int64_t>
+                                                  (max_coords_[dim]) - min_coords_[dim] + 1);
+
+    if (num_cells > (std::numeric_limits<uint64_t>::max() - kPageMask) / extent) {
+      std::ostringstream ss;
+      ss << "Lattice has more than 2^64 cells" << std::endl;
+      throw std::runtime_error(ss.str());
+    }
+
+    strides_[dim] = num_cells;
+    num_cells *= extent;
+  }
+
+  const uint64_t num_pages = (num_cells + kPageMask) >> kPageBits;
+
+  if (num_pages > pages_.max_size()) {
+    std::ostringstream ss;
+    ss << "Lattice of " << num_cells << " cells needs too large a page directory"
+       << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  pages_.resize(static_cast<size_t>(num_pages));
+}
+
+template<class HashableState>
+size_t DenseGridHashManager<HashableState>::Size() const {
+  return states_.Size();
+}
+
+template<class HashableState>
+bool DenseGridHashManager<HashableState>::CellIndex(
+  const HashableState &hashable_state, uint64_t *cell) const {
+  const Coordinates coords = LatticeCoordinates<HashableState>::Get(
+                               hashable_state);
+  *cell = 0;
+
+  for (size_t dim = 0; dim < kDimensions; ++dim) {
+    if (coords[dim] < min_coords_[dim] || coords[dim] > max_coords_[dim]) {
+      return false;
+    }
+
+    *cell += static_cast<uint64_t>(static_cast<int64_t>(coords[dim]) -
+                                   min_coords_[dim]) * strides_[dim];
+  }
+
+  return true;
+}
+
+template<class HashableState>
+uint64_t DenseGridHashManager<HashableState>::CellIndexForInsert(
+  const HashableState &hashable_state) const {
+  uint64_t cell = 0;
+
+  if (!CellIndex(hashable_state, &cell)) {
+    std::ostringstream ss;
+    ss << "Asked to insert a state outside the lattice bounds: " << std::endl <<
+       hashable_state << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  return cell;
+}
+
+template<class HashableState>
+unsigned int DenseGridHashManager<HashableState>::CellStateID(
+  uint64_t cell) const {
+  const unsigned int *page = pages_[cell >> kPageBits].get();
+  return page == nullptr ? kInvalidStateID : page[cell & kPageMask];
+}
+
+template<class HashableState>
+unsigned int &DenseGridHashManager<HashableState>::CellForInsert(
+  uint64_t cell) {
+  std::unique_ptr<unsigned int[]> &page = pages_[cell >> kPageBits];
+
+  if (!page) {
+    page.reset(new unsigned int[kPageSize]);
+    std::fill(page.get(), page.get() + kPageSize, kInvalidStateID);
+    ++num_allocated_pages_;
+  }
+
+  return page[cell & kPageMask];
+}
+
+template<class HashableState>
+unsigned int DenseGridHashManager<HashableState>::FindStateID(
+  const HashableState &hashable_state) const {
+  uint64_t cell = 0;
+  return CellIndex(hashable_state, &cell) ? CellStateID(cell) : kInvalidStateID;
+}
+
+template<class HashableState>
+bool DenseGridHashManager<HashableState>::InBounds(
+  const HashableState &hashable_state) const {
+  uint64_t cell = 0;
+  return CellIndex(hashable_state, &cell);
+}
+
+template<class HashableState>
+bool DenseGridHashManager<HashableState>::Exists(
+  const HashableState &hashable_state) const {
+  return FindStateID(hashable_state) != kInvalidStateID;
+}
+
+template<class HashableState>
+bool DenseGridHashManager<HashableState>::Exists(unsigned int state_id) const {
+  return states_.Exists(state_id);
+}
+
+template<class HashableState>
+unsigned int DenseGridHashManager<HashableState>::GetStateID(
+  const HashableState &hashable_state) const {
+  const unsigned int state_id = FindStateID(hashable_state);
+
+  if (state_id == kInvalidStateID) {
+    std::ostringstream ss;
+    ss << "Asked for non-existent state: " << std::endl << hashable_state <<
+       std::endl;
+    Print(std::cout, kMaxStatesPrintedOnError);
+    throw std::runtime_error(ss.str());
+  }
+
+  return state_id;
+}
+
+template<class HashableState>
+const HashableState &DenseGridHashManager<HashableState>::GetState(
+  unsigned int state_id) const {
+  const HashableState *hashable_state = states_.Find(state_id);
+
+  if (hashable_state == nullptr) {
+    std::ostringstream ss;
+    ss << "Asked for non-existent state ID: " <<  state_id << std::endl;
+    Print(std::cout, kMaxStatesPrintedOnError);
+    throw std::runtime_error(ss.str());
+  }
+
+  return *hashable_state;
+}
+
+template<class HashableState>
+typename DenseGridHashManager<HashableState>::Coordinates
+DenseGridHashManager<HashableState>::GetCoordinates(unsigned int state_id) const {
+  return LatticeCoordinates<HashableState>::Get(GetState(state_id));
+}
+
+// Non-const methods
+template<class HashableState>
+unsigned int DenseGridHashManager<HashableState>::GetStateIDForceful(
+  const HashableState &hashable_state) {
+  unsigned int &cell_state_id = CellForInsert(CellIndexForInsert(
+                                                hashable_state));
+
+  if (cell_state_id == kInvalidStateID) {
+    const unsigned int new_state_id = states_.NextFreeID();
+    states_.Emplace(new_state_id, hashable_state);
+    cell_state_id = new_state_id;
+  }
+
+  return cell_state_id;
+}
+
+template<class HashableState>
+unsigned int DenseGridHashManager<HashableState>::GetStateIDForceful(
+  HashableState &&hashable_state) {
+  unsigned int &cell_state_id = CellForInsert(CellIndexForInsert(
+                                                hashable_state));
+
+  if (cell_state_id == kInvalidStateID) {
+    const unsigned int new_state_id = states_.NextFreeID();
+    states_.Emplace(new_state_id, std::move(hashable_state));
+    cell_state_id = new_state_id;
+  }
+
+  return cell_state_id;
+}
+
+template<class HashableState>
+template<typename... Args>
+unsigned int DenseGridHashManager<HashableState>::EmplaceState(
+  Args &&... args) {
+  return GetStateIDForceful(HashableState(std::forward<Args>(args)...));
+}
+
+template<class HashableState>
+void DenseGridHashManager<HashableState>::GetStateIDsForceful(
+  const HashableState *hashable_states, size_t num_states,
+  unsigned int *state_ids) {
+  for (size_t ii = 0; ii < num_states; ++ii) {
+    state_ids[ii] = GetStateIDForceful(hashable_states[ii]);
+  }
+}
+
+template<class HashableState>
+void DenseGridHashManager<HashableState>::GetStateIDsForceful(
+  const std::vector<HashableState> &hashable_states,
+  std::vector<unsigned int> *state_ids) {
+  state_ids->resize(hashable_states.size());
+  GetStateIDsForceful(hashable_states.data(), hashable_states.size(),
+                      state_ids->data());
+}
+
+template<class HashableState>
+unsigned int DenseGridHashManager<HashableState>::GetStateIDForUpdate(
+  const HashableState &hashable_state) const {
+  const unsigned int state_id = FindStateID(hashable_state);
+
+  if (state_id == kInvalidStateID) {
+    std::ostringstream ss;
+    ss << "Asked to update a non-existent state " << std::endl << hashable_state <<
+       std::endl;
+    Print(std::cout, kMaxStatesPrintedOnError);
+    throw std::runtime_error(ss.str());
+  }
+
+  return state_id;
+}
+
+template<class HashableState>
+void DenseGridHashManager<HashableState>::UpdateState(
+  const HashableState &hashable_state) {
+  *states_.Find(GetStateIDForUpdate(hashable_state)) = hashable_state;
+}
+
+template<class HashableState>
+void DenseGridHashManager<HashableState>::UpdateState(
+  HashableState &&hashable_state) {
+  *states_.Find(GetStateIDForUpdate(hashable_state)) = std::move(hashable_state);
+}
+
+template<class HashableState>
+template<typename Function>
+void DenseGridHashManager<HashableState>::ModifyState(unsigned int state_id,
+                                                      Function fn) {
+  HashableState *hashable_state = states_.Find(state_id);
+
+  if (hashable_state == nullptr) {
+    std::ostringstream ss;
+    ss << "Asked to modify a non-existent state ID: " << state_id << std::endl;
+    Print(std::cout, kMaxStatesPrintedOnError);
+    throw std::runtime_error(ss.str());
+  }
+
+  fn(*hashable_state);
+}
+
+template<class HashableState>
+void DenseGridHashManager<HashableState>::InsertState(
+  const HashableState &hashable_state, int state_id) {
+  const uint64_t cell = CellIndexForInsert(hashable_state);
+
+  if (CellStateID(cell) != kInvalidStateID) {
+    std::ostringstream ss;
+    ss << "Asked to insert an already existent state " << std::endl <<
+       hashable_state << std::endl;
+    Print(std::cout, kMaxStatesPrintedOnError);
+    throw std::runtime_error(ss.str());
+  }
+
+  if (states_.Exists(state_id)) {
+    std::ostringstream ss;
+    ss << "Asked to insert a state with an already used state ID: " << state_id
+       << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  states_.Emplace(state_id, hashable_state);
+  CellForInsert(cell) = state_id;
+}
+
+template<class HashableState>
+void DenseGridHashManager<HashableState>::Reset() {
+  for (auto &page : pages_) {
+    page.reset();
+  }
+
+  num_allocated_pages_ = 0;
+  states_.Clear();
+}
+
+template<class HashableState>
+void DenseGridHashManager<HashableState>::Print() const {
+  Print(std::cout, Size());
+}
+
+template<class HashableState>
+void DenseGridHashManager<HashableState>::Print(std::ostream &stream,
+                                                size_t max_states) const {
+  internal::PrintStates(stream, states_, max_states);
+}
+}  // namespace sbpl_utils
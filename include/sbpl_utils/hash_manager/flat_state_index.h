@@ -0,0 +1,424 @@
+#pragma once
+
+#include <sbpl_utils/hash_manager/hash_utils.h>
+#include <sbpl_utils/hash_manager/state_store.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace sbpl_utils {
+
+// Open-addressing ("swiss table" style) hash index from states to state IDs.
+// It can be used in place of ChainedStateIndex via the StateIndex template
+// parameter of HashManager, e.g. HashManager<StateXY, FlatStateIndex>, or
+// through the FlatHashManager alias.
+//
+// The table is an array of groups. Each group holds one metadata byte per slot
+// followed by the slots' state IDs, so that a group's metadata and IDs share
+// adjacent cache lines. A metadata byte is either kEmpty or the top 7 bits of
+// the slot's hash. Lookups compare a whole group of metadata bytes against the
+// probe's 7 bits at once (16 bytes with SSE2, 32 with AVX2), so only slots
+// whose metadata matches are ever compared against the stored states, and a
+// probe typically touches one group and one state. Full hashes are cached in a
+// separate array that is only read when the table grows, so growing never
+// calls GetHash() again.
+//
+// Groups are stamped with a generation, so Recycle() can empty the index in
+// O(1) while keeping its memory: a group from an older generation reads as
+// empty and has its metadata wiped when it is next written.
+//
+// All memory is obtained from Allocator (see HashManager). Use the
+// FlatStateIndex alias for the default allocator.
+template <class Allocator = std::allocator<char>>
+class BasicFlatStateIndex {
+ public:
+  // The same index type with a different allocator.
+  template <class OtherAllocator>
+  using Rebind = BasicFlatStateIndex<OtherAllocator>;
+
+  explicit BasicFlatStateIndex(const Allocator &allocator = Allocator()) :
+    groups_(GroupAllocator(allocator)), hashes_(HashAllocator(allocator)) {}
+
+  // Number of IDs in the index.
+  size_t Size() const {
+    return size_;
+  }
+
+  // Returns the ID of the stored state for which equal(state_id) holds, or
+  // kInvalidStateID if there is none.
+  template <typename Equal>
+  unsigned int Find(size_t hash, Equal equal) const;
+
+  // Adds state_id under the given hash. The caller guarantees that no equal
+  // state is already present.
+  void Insert(size_t hash, unsigned int state_id) {
+    FindOrInsert(hash, [](unsigned int) {
+      return false;
+    }, state_id);
+  }
+
+  // Single-probe combination of Find and Insert: returns the ID of the state
+  // for which equal(state_id) holds if there is one, otherwise adds
+  // new_state_id under hash and returns it.
+  template <typename Equal>
+  unsigned int FindOrInsert(size_t hash, Equal equal, unsigned int new_state_id);
+
+  // Hint that the group for hash is about to be looked up.
+  void Prefetch(size_t hash) const {
+    if (!groups_.empty()) {
+      __builtin_prefetch(&groups_[static_cast<size_t>(HashMix(hash)) & group_mask_]);
+    }
+  }
+
+  // Grows the index so that it holds num_states IDs without rehashing.
+  void Reserve(size_t num_states);
+
+  void Clear() {
+    // Swap with empty vectors to release the memory, too.
+    GroupVector(groups_.get_allocator()).swap(groups_);
+    HashVector(hashes_.get_allocator()).swap(hashes_);
+    size_ = 0;
+    group_mask_ = 0;
+    generation_ = 0;
+  }
+
+  // Removes all IDs in O(1), keeping the memory for reuse.
+  void Recycle();
+
+  // Fraction of slots in use.
+  double LoadFactor() const {
+    return Capacity() == 0 ? 0.0 : static_cast<double>(size_) / Capacity();
+  }
+
+  // Heap memory held by the index, in bytes.
+  size_t MemoryBytes() const {
+    return groups_.capacity() * sizeof(Group) + hashes_.capacity() * sizeof(
+             size_t);
+  }
+
+  // Slot occupancy, probe lengths (in groups) and hash collisions.
+  HashDiagnostics Diagnostics() const;
+
+ private:
+  static constexpr int8_t kEmpty = -128;
+  static constexpr size_t kMinGroups = 1;
+
+  // A group of metadata bytes that is matched in parallel.
+  class GroupMatcher {
+   public:
+#if defined(__AVX2__)
+    static constexpr size_t kWidth = 32;
+    explicit GroupMatcher(const int8_t *ctrl) : ctrl_(_mm256_loadu_si256(
+                                                   reinterpret_cast<const __m256i *>(ctrl))) {}
+    // Bitmask of the positions whose metadata equals h2.
+    uint32_t Match(int8_t h2) const {
+      return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                                                           _mm256_set1_epi8(h2), ctrl_)));
+    }
+   private:
+    __m256i ctrl_;
+#elif defined(__SSE2__)
+    static constexpr size_t kWidth = 16;
+    explicit GroupMatcher(const int8_t *ctrl) : ctrl_(_mm_loadu_si128(
+                                                   reinterpret_cast<const __m128i *>(ctrl))) {}
+    uint32_t Match(int8_t h2) const {
+      return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+                                                        _mm_set1_epi8(h2), ctrl_)));
+    }
+   private:
+    __m128i ctrl_;
+#else
+    static constexpr size_t kWidth = 16;
+    explicit GroupMatcher(const int8_t *ctrl) : ctrl_(ctrl) {}
+    uint32_t Match(int8_t h2) const {
+      uint32_t mask = 0;
+
+      for (size_t ii = 0; ii < kWidth; ++ii) {
+        mask |= static_cast<uint32_t>(ctrl_[ii] == h2) << ii;
+      }
+
+      return mask;
+    }
+   private:
+    const int8_t *ctrl_;
+#endif
+   public:
+    uint32_t MatchEmpty() const {
+      return Match(kEmpty);
+    }
+  };
+
+  // GetHash() implementations are often weak, so hashes are remixed with
+  // HashMix before being split into the group index (low bits) and the 7-bit
+  // metadata (high bits).
+  static int8_t H2(uint64_t mixed_hash) {
+    return static_cast<int8_t>(mixed_hash >> 57);
+  }
+
+  static constexpr size_t kGroupWidth = GroupMatcher::kWidth;
+
+  struct Group {
+    int8_t ctrl[kGroupWidth];
+    // Generation of the index in which ctrl was last valid.
+    unsigned int generation;
+    unsigned int state_ids[kGroupWidth];
+  };
+
+  bool IsLive(const Group &group) const {
+    return group.generation == generation_;
+  }
+
+  // Wipes a stale group's metadata so that it can be written.
+  void Refresh(Group *group) const {
+    if (!IsLive(*group)) {
+      std::fill(group->ctrl, group->ctrl + kGroupWidth,
+                static_cast<int8_t>(kEmpty));
+      group->generation = generation_;
+    }
+  }
+
+  size_t Capacity() const {
+    return groups_.size() * kGroupWidth;
+  }
+
+  void Rehash(size_t num_groups);
+
+  // Places state_id in the first empty slot of its probe sequence.
+  void InsertUnchecked(size_t hash, unsigned int state_id);
+
+  typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Group>
+  GroupAllocator;
+  typedef typename std::allocator_traits<Allocator>::template rebind_alloc<size_t>
+  HashAllocator;
+  typedef std::vector<Group, GroupAllocator> GroupVector;
+  typedef std::vector<size_t, HashAllocator> HashVector;
+
+  GroupVector groups_;
+  // Full hash of every slot, indexed by group * kGroupWidth + slot.
+  HashVector hashes_;
+  size_t size_ = 0;
+  size_t group_mask_ = 0;
+  unsigned int generation_ = 0;
+};
+
+typedef BasicFlatStateIndex<> FlatStateIndex;
+
+///////////////////////////////////////////////////////////////////////////////
+// Template Inline Implementation
+///////////////////////////////////////////////////////////////////////////////
+
+template <class Allocator>
+template <typename Equal>
+unsigned int BasicFlatStateIndex<Allocator>::Find(size_t hash, Equal equal) const {
+  if (size_ == 0) {
+    return kInvalidStateID;
+  }
+
+  const uint64_t mixed_hash = HashMix(hash);
+  const int8_t h2 = H2(mixed_hash);
+  size_t group = static_cast<size_t>(mixed_hash) & group_mask_;
+
+  // Triangular probing visits every group when the group count is a power of
+  // two.
+  for (size_t step = 1; ; ++step) {
+    const Group &g = groups_[group];
+
+    // A stale group is empty, which ends the probe sequence.
+    if (!IsLive(g)) {
+      return kInvalidStateID;
+    }
+
+    const GroupMatcher matcher(g.ctrl);
+
+    for (uint32_t match = matcher.Match(h2); match != 0; match &= match - 1) {
+      const unsigned int state_id = g.state_ids[__builtin_ctz(match)];
+
+      if (equal(state_id)) {
+        return state_id;
+      }
+    }
+
+    // There are no deletions, so an empty slot terminates the probe sequence.
+    if (matcher.MatchEmpty() != 0) {
+      return kInvalidStateID;
+    }
+
+    group = (group + step) & group_mask_;
+  }
+}
+
+template <class Allocator>
+template <typename Equal>
+unsigned int BasicFlatStateIndex<Allocator>::FindOrInsert(size_t hash, Equal equal,
+                                          unsigned int new_state_id) {
+  // Grow up front, so that the probe below also finds the insertion slot.
+  // Keep the load factor at or below 7/8.
+  if ((size_ + 1) * 8 > Capacity() * 7) {
+    Rehash(Capacity() == 0 ? size_t(kMinGroups) : 2 * (group_mask_ + 1));
+  }
+
+  const uint64_t mixed_hash = HashMix(hash);
+  const int8_t h2 = H2(mixed_hash);
+  size_t group = static_cast<size_t>(mixed_hash) & group_mask_;
+
+  for (size_t step = 1; ; ++step) {
+    Group &g = groups_[group];
+    Refresh(&g);
+    const GroupMatcher matcher(g.ctrl);
+
+    for (uint32_t match = matcher.Match(h2); match != 0; match &= match - 1) {
+      const unsigned int state_id = g.state_ids[__builtin_ctz(match)];
+
+      if (equal(state_id)) {
+        return state_id;
+      }
+    }
+
+    // Without deletions, the group that ends the probe sequence is exactly
+    // where InsertUnchecked would put the new entry.
+    const uint32_t empty = matcher.MatchEmpty();
+
+    if (empty != 0) {
+      const size_t slot = __builtin_ctz(empty);
+      g.ctrl[slot] = h2;
+      g.state_ids[slot] = new_state_id;
+      hashes_[group * kGroupWidth + slot] = hash;
+      ++size_;
+      return new_state_id;
+    }
+
+    group = (group + step) & group_mask_;
+  }
+}
+
+template <class Allocator>
+void BasicFlatStateIndex<Allocator>::Rehash(size_t num_groups) {
+  Group empty_group;
+  std::fill(empty_group.ctrl, empty_group.ctrl + kGroupWidth,
+            static_cast<int8_t>(kEmpty));
+  empty_group.generation = generation_;
+  std::fill(empty_group.state_ids, empty_group.state_ids + kGroupWidth,
+            kInvalidStateID);
+
+  GroupVector old_groups(num_groups, empty_group, groups_.get_allocator());
+  HashVector old_hashes(num_groups * kGroupWidth, 0, hashes_.get_allocator());
+  old_groups.swap(groups_);
+  old_hashes.swap(hashes_);
+  group_mask_ = num_groups - 1;
+
+  for (size_t group = 0; group < old_groups.size(); ++group) {
+    if (!IsLive(old_groups[group])) {
+      continue;
+    }
+
+    for (size_t slot = 0; slot < kGroupWidth; ++slot) {
+      if (old_groups[group].ctrl[slot] != kEmpty) {
+        InsertUnchecked(old_hashes[group * kGroupWidth + slot],
+                        old_groups[group].state_ids[slot]);
+      }
+    }
+  }
+}
+
+template <class Allocator>
+void BasicFlatStateIndex<Allocator>::InsertUnchecked(size_t hash,
+                                            unsigned int state_id) {
+  const uint64_t mixed_hash = HashMix(hash);
+  size_t group = static_cast<size_t>(mixed_hash) & group_mask_;
+
+  for (size_t step = 1; ; ++step) {
+    Group &g = groups_[group];
+    Refresh(&g);
+    const uint32_t empty = GroupMatcher(g.ctrl).MatchEmpty();
+
+    if (empty != 0) {
+      const size_t slot = __builtin_ctz(empty);
+      g.ctrl[slot] = H2(mixed_hash);
+      g.state_ids[slot] = state_id;
+      hashes_[group * kGroupWidth + slot] = hash;
+      return;
+    }
+
+    group = (group + step) & group_mask_;
+  }
+}
+
+template <class Allocator>
+void BasicFlatStateIndex<Allocator>::Reserve(size_t num_states) {
+  size_t num_groups = kMinGroups;
+
+  while (num_states * 8 > num_groups * kGroupWidth * 7) {
+    num_groups *= 2;
+  }
+
+  if (num_groups > groups_.size()) {
+    Rehash(num_groups);
+  }
+}
+
+template <class Allocator>
+void BasicFlatStateIndex<Allocator>::Recycle() {
+  size_ = 0;
+
+  // Once the generation wraps around, stale groups could pass for live ones.
+  if (++generation_ == 0) {
+    for (Group &group : groups_) {
+      group.generation = 1;
+      Refresh(&group);
+    }
+  }
+}
+
+template <class Allocator>
+HashDiagnostics BasicFlatStateIndex<Allocator>::Diagnostics() const {
+  HashDiagnostics diagnostics;
+  diagnostics.num_states = size_;
+  diagnostics.num_buckets = Capacity();
+  std::vector<size_t> hashes;
+  hashes.reserve(size_);
+  size_t total_probe_length = 0;
+
+  for (size_t group = 0; group < groups_.size(); ++group) {
+    if (!IsLive(groups_[group])) {
+      continue;
+    }
+
+    for (size_t slot = 0; slot < kGroupWidth; ++slot) {
+      if (groups_[group].ctrl[slot] == kEmpty) {
+        continue;
+      }
+
+      const size_t hash = hashes_[group * kGroupWidth + slot];
+      hashes.push_back(hash);
+      ++diagnostics.num_occupied_buckets;
+
+      // Replay the probe sequence to see how many groups a lookup of this
+      // entry visits.
+      size_t probe_group = static_cast<size_t>(HashMix(hash)) & group_mask_;
+      size_t probe_length = 1;
+
+      for (size_t step = 1; probe_group != group; ++step, ++probe_length) {
+        probe_group = (probe_group + step) & group_mask_;
+      }
+
+      total_probe_length += probe_length;
+      diagnostics.max_probe_length = std::max(diagnostics.max_probe_length,
+                                              probe_length);
+    }
+  }
+
+  diagnostics.num_colliding_states = internal::CountCollidingHashes(hashes);
+  diagnostics.mean_probe_length = size_ == 0 ? 0.0 :
+                                  static_cast<double>(total_probe_length) / size_;
+  return diagnostics;
+}
+}  // namespace sbpl_utils
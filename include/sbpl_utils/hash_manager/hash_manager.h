@@ -1,12 +1,24 @@
 #pragma once
 
+#include <sbpl_utils/common/arena.h>
+#include <sbpl_utils/hash_manager/flat_state_index.h>
+#include <sbpl_utils/hash_manager/hash_manager_stats.h>
+#include <sbpl_utils/hash_manager/state_id_remap.h>
+#include <sbpl_utils/hash_manager/state_index.h>
+#include <sbpl_utils/hash_manager/state_observer.h>
+#include <sbpl_utils/hash_manager/state_snapshot.h>
+#include <sbpl_utils/hash_manager/state_store.h>
+
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <stdexcept>
-#include <unordered_map>
-#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace sbpl_utils {
 // A generic hash manager for maintaining a two-way mapping between states and unique IDs.
@@ -25,15 +37,55 @@ namespace sbpl_utils {
 //        return successor_ids;
 //      }
 //
+// When all successors of an expansion are generated up front, the batch call
+//      hash_manager.GetStateIDsForceful(successor_states, &successor_ids);
+// does the same with the hash table lookups of the whole batch overlapped.
+//
 // Optionally, if HashableState implementes an ostream<< operator, useful debug information will be printed if a state
-// is not found in the hash manager.
+// is not found in the hash manager. At most kMaxStatesPrintedOnError states are printed, however large the table.
+//
+// GetStats() reports the table's size and memory use along with cumulative
+// lookup, hit, insertion and probe counters that are always maintained, and
+// optionally the time spent in lookups (see EnableTiming()).
 //
 // Other features include 'updating' a state while preserving its state ID, like in scenarios where we might update the
-// continuous coordinates while keeping the discrete coordinates fixed, or when
-// upating a state's g-value or best action when used on the planner side.
+// continuous coordinates while keeping the discrete coordinates fixed.
+//
+// Planner-side data that changes during a search, such as g-values, parents or best actions, should not be stored
+// in the states: UpdateState copies the whole state on every change. Keep it in a StateDataStore (or the
+// SearchDataStore preset) indexed by state ID instead.
+//
+// Long-running planners (anytime or incremental replanning) can drop the states they no longer need with
+// Compact(), which renumbers the survivors densely and returns a StateIDRemap for the caller's own ID-indexed data
+// (see StateDataStore::ApplyRemap()).
 //
 // Passive consumers (that won't add new states to the hash manager) can use a std::shared_ptr<const HashManager>
-// to access the mappings.
+// to access the mappings, as long as nothing modifies the hash manager meanwhile. Observers on other threads that
+// need to follow a hash manager while it is in use, e.g. to visualize a running search, should read it through a
+// StateObserver instead (see AddObserver()).
+//
+// Each state is stored exactly once, in an ID-indexed StateStore. The hash
+// index that maps states back to IDs only holds state IDs and compares probe
+// states against the stored copies, so heavy states are neither duplicated
+// nor copied more than once on insertion.
+//
+// For repeated planning in the same environment, the table can be saved with
+// SaveSnapshot() and a later hash manager warm-started from it with
+// LoadSnapshot(), instead of being rebuilt state by state. Snapshot files can
+// also be opened directly as a read-only, memory-mapped StateSnapshot.
+//
+// All memory of the hash manager itself (state storage and hash index) is
+// obtained from the Allocator template parameter. A search-local hash manager
+// can draw from a MonotonicArena through an ArenaAllocator, so that all its
+// memory is released in one shot when the search ends, e.g.
+//      MonotonicArena arena;
+//      HashManager<StateXY, ChainedStateIndex, ArenaAllocator<StateXY>> hash_manager(
+//        ArenaAllocator<StateXY>(&arena));
+//
+// The StateIndex template parameter selects the hash index implementation:
+// ChainedStateIndex (the default) or the open-addressing FlatStateIndex, which
+// probes groups of slots with SIMD instructions and is usually the faster
+// choice for duplicate detection (see FlatHashManager below).
 
 // Utility to check if the ostream << operator exists for a given template type.
 template <typename T>
@@ -61,7 +113,37 @@ std::ostream & operator<< (std::ostream &stream, const HashableState &state) {
   return stream;
 }
 
-template<class HashableState>
+namespace internal {
+// Prints up to max_states of the states in a StateStore, in ID order.
+template<class HashableState, class Allocator>
+void PrintStates(std::ostream &stream,
+                 const StateStore<HashableState, Allocator> &states, size_t max_states) {
+  stream << std::right << std::setfill('*')
+         << std::setw(50) << "Begin Hash Table" << std::endl;
+  size_t num_printed = 0;
+
+  for (auto it = states.begin(); it != states.end() &&
+       num_printed < max_states; ++it, ++num_printed) {
+    stream << "State ID: " << it->second << std::endl;
+    stream << it->first << std::endl;
+    stream << std::string(10, '-') << std::endl;
+  }
+
+  if (num_printed < states.Size()) {
+    stream << "... and " << states.Size() - num_printed << " more states" <<
+           std::endl;
+  }
+
+  stream << std::right << std::setfill('*')
+         << std::setw(50) << "End Hash Table" << std::endl;
+}
+}  // namespace internal
+
+// Upper bound on the number of states printed when a method throws.
+constexpr size_t kMaxStatesPrintedOnError = 10;
+
+template<class HashableState, class StateIndex = ChainedStateIndex,
+         class Allocator = std::allocator<HashableState>>
 class HashManager {
  public:
   struct HashFunction {
@@ -70,13 +152,20 @@ class HashManager {
     }
   };
 
-  HashManager();
+  explicit HashManager(const Allocator &allocator = Allocator());
+  // Copies have no observers; moves take the observers along.
+  HashManager(const HashManager &other) = default;
+  HashManager(HashManager &&other) = default;
+  HashManager &operator=(HashManager other);
+  ~HashManager();
 
   // Return the number of states in the hash manager.
   size_t Size() const;
 
   // Print all states stored by the hash manager.
   void Print() const;
+  // Print at most max_states states.
+  void Print(std::ostream &stream, size_t max_states) const;
 
   bool Exists(const HashableState &hashable_state) const;
   bool Exists(unsigned int state_id) const;
@@ -89,158 +178,609 @@ class HashManager {
 
   // Adds a new entry to hash table if one does not exist and returns the state ID.
   // If state already exists, returns existing state ID.
+  // The state is hashed once, and if it already exists the table is probed
+  // once and nothing is copied. A new state is copied into the hash manager
+  // (moved by the rvalue overload) before it is indexed, so that a throwing
+  // copy or move leaves the hash manager as it was.
   unsigned int GetStateIDForceful(const HashableState &hashable_state);
+  unsigned int GetStateIDForceful(HashableState &&hashable_state);
+
+  // Like GetStateIDForceful, but constructs the state from args directly in
+  // the hash manager's storage. If an equal state already exists, the newly
+  // constructed one is destroyed and the existing ID is returned.
+  template<typename... Args>
+  unsigned int EmplaceState(Args &&... args);
+
+  // Batch version of GetStateIDForceful, e.g. for all successors of an
+  // expansion: state_ids[i] is set to the ID of hashable_states[i]. Hashes are
+  // computed and the corresponding buckets prefetched ahead of resolving the
+  // states, so the memory latency of the lookups overlaps. If a state fails
+  // to be copied, the states before it remain inserted.
+  void GetStateIDsForceful(const HashableState *hashable_states,
+                           size_t num_states, unsigned int *state_ids);
+  void GetStateIDsForceful(const std::vector<HashableState> &hashable_states,
+                           std::vector<unsigned int> *state_ids);
 
   // If state does not already exist in the hash table, run time error is thrown.
   // Preserves the old state ID.
   void UpdateState(const HashableState &hashable_state);
+  void UpdateState(HashableState &&hashable_state);
+
+  // In-place version of UpdateState: invokes fn(HashableState &) on the stored
+  // state with the given ID. fn must not change anything that GetHash() or
+  // operator== depend on. Throws if the state ID does not exist.
+  template<typename Function>
+  void ModifyState(unsigned int state_id, Function fn);
 
   // Allow users to insert states directly into the hasher if they know the
-  // state ID. This will throw if the hashable_state is already present in the
-  // hash manager.
+  // state ID. This will throw if the hashable_state or the state ID is already
+  // present in the hash manager. Subsequent calls to GetStateIDForceful will
+  // skip over IDs taken this way.
   void InsertState(const HashableState &hashable_state, int state_id);
 
-  // Clear the hash manager.
+  // Clear the hash manager. Allocated memory is kept for the next query, and
+  // unless states need non-trivial destructors this takes O(1) time: storage
+  // and index entries are invalidated by bumping a generation counter rather
+  // than being freed. If the hash manager holds more states than the limit set
+  // with SetMaxRetainedStates(), all memory is released instead.
   void Reset();
 
-  const std::unordered_map<HashableState, unsigned int, HashFunction>
-  &GetStateMappings() const {
-    return state_to_state_id_;
+  // Drops every state for which keep(state_id, hashable_state) returns false
+  // and renumbers the survivors densely, in the order of their old IDs, e.g.
+  // between iterations of an anytime or incremental planner. Storage and
+  // index are rebuilt at the survivors' size, releasing the memory of the
+  // dropped states. Returns the old to new ID mapping, to be applied to any
+  // data the caller keeps by state ID.
+  template<typename Predicate>
+  StateIDRemap Compact(Predicate keep);
+  // Keeps exactly the given states. Throws error if any of them does not
+  // exist.
+  StateIDRemap Compact(const std::vector<unsigned int> &live_state_ids);
+
+  // Shrink policy for Reset(): memory is only kept across resets of hash
+  // managers holding at most max_states states. Unlimited by default; 0 makes
+  // Reset() always release memory.
+  void SetMaxRetainedStates(size_t max_states) {
+    max_retained_states_ = max_states;
+  }
+
+  // Write all states and their IDs to a binary snapshot file (see
+  // StateSnapshot). Only available for trivially copyable states. Throws error
+  // on I/O failure.
+  void SaveSnapshot(const std::string &path) const {
+    WriteStateSnapshot(path, states_);
+  }
+
+  // Replace the contents of the hash manager with those of a snapshot,
+  // preserving state IDs. GetHash() is not called: the index is rebuilt from
+  // the hashes stored in the snapshot.
+  void LoadSnapshot(const StateSnapshot<HashableState> &snapshot);
+  void LoadSnapshot(const std::string &path) {
+    LoadSnapshot(StateSnapshot<HashableState>(path));
+  }
+
+  // Reports how well GetHash() spreads the stored states over the index:
+  // bucket occupancy, maximum and mean chain/probe length, and the fraction of
+  // states whose hash collides with another state's.
+  HashDiagnostics GetHashDiagnostics() const {
+    return state_index_.Diagnostics();
+  }
+
+  // Current size, memory use and usage counters.
+  HashManagerStats GetStats() const;
+
+  // Zero the usage counters.
+  void ResetStats() {
+    counters_ = internal::HashManagerCounters();
+  }
+
+  // Measure the time spent in lookups and insertions (off by default, since it
+  // reads the clock twice per call).
+  void EnableTiming(bool enabled) {
+    timing_enabled_ = enabled;
+  }
+
+  // Iterable view over all (state, state ID) pairs, i.e. entry.first is the
+  // state and entry.second its ID. This used to be a const reference to a
+  // std::unordered_map; the view keeps its iteration, size(), empty(),
+  // find(), count() and at(), but not the rest of the map interface.
+  StateMappings<HashableState, Allocator> GetStateMappings() const {
+    return StateMappings<HashableState, Allocator>(states_,
+    [this](const HashableState & hashable_state) {
+      return FindStateID(hashable_state, hashable_state.GetHash());
+    });
+  }
+
+  // Returns an observer through which another thread can read the states
+  // while this hash manager keeps being used, without locks on either side
+  // (see StateObserver). Observers see the states with IDs 0..n-1 for the
+  // largest n such that all of them exist, as of the end of the last call
+  // that added states. Throws error if there are already
+  // EpochDomain::kMaxReaders observers.
+  //
+  // Once a hash manager has observers, Reset() hands its storage over to them
+  // instead of reusing it, and destroying the hash manager leaves the last
+  // published states readable until the observers are destroyed. States must
+  // not be modified in place (UpdateState(), ModifyState()) while observed.
+  // Call from the thread that uses the hash manager.
+  StateObserver<HashableState> AddObserver() {
+    return publisher_.AddObserver(states_);
   }
 
  private:
-  std::unordered_map<HashableState, unsigned int, HashFunction>
-  state_to_state_id_;
-  std::unordered_map<unsigned int, HashableState> state_id_to_state_;
+  // Returns the ID of a stored state equal to hashable_state, or
+  // kInvalidStateID.
+  unsigned int FindStateID(const HashableState &hashable_state,
+                           size_t hash) const;
+  // Returns the ID of a stored state equal to hashable_state if there is one,
+  // otherwise indexes hashable_state under new_state_id (without storing it)
+  // and returns new_state_id.
+  unsigned int FindOrIndexState(const HashableState &hashable_state, size_t hash,
+                                unsigned int new_state_id);
+  // Indexes the just stored state new_state_id unless an equal state is
+  // already stored, in which case the new state is erased again. Returns the
+  // ID of the indexed state. If indexing throws, the new state is erased as
+  // well. Only for EmplaceState, which cannot probe before constructing.
+  unsigned int IndexStoredState(unsigned int new_state_id, size_t hash);
+  // Stores a state constructed from args under a new ID and indexes it under
+  // hash, for states known not to exist. Returns the new ID. The state is
+  // stored before it is indexed, so that the index never refers to a state
+  // whose construction threw; if indexing throws, the state is erased again.
+  template<typename... Args>
+  unsigned int StoreNewState(size_t hash, Args &&... args);
+  // Throws for UpdateState calls on states that do not exist.
+  unsigned int GetStateIDForUpdate(const HashableState &hashable_state) const;
+
+  // States are addressed directly by their (dense) IDs.
+  StateStore<HashableState, Allocator> states_;
+  // Maps states to IDs by looking up the copies in states_.
+  typename StateIndex::template Rebind<Allocator> state_index_;
+  // Mutable, since lookups are const.
+  internal::HashManagerCounters counters_;
+  bool timing_enabled_ = false;
+  size_t max_retained_states_ = std::numeric_limits<size_t>::max();
+  // Publishes states_ to observers, if there are any.
+  StatePublisher<HashableState> publisher_;
 };
 
+// HashManager backed by the open-addressing index.
+template<class HashableState>
+using FlatHashManager = HashManager<HashableState, FlatStateIndex>;
+
 ///////////////////////////////////////////////////////////////////////////////
 // Template Inline Implementation
 ///////////////////////////////////////////////////////////////////////////////
 
-template<class HashableState>
-HashManager<HashableState>::HashManager() {};
+template<class HashableState, class StateIndex, class Allocator>
+HashManager<HashableState, StateIndex, Allocator>::HashManager(
+  const Allocator &allocator) : states_(allocator), state_index_(allocator) {}
+
+template<class HashableState, class StateIndex, class Allocator>
+HashManager<HashableState, StateIndex, Allocator>
+&HashManager<HashableState, StateIndex, Allocator>::operator=(
+  HashManager other) {
+  // Observers may still be reading the current states.
+  publisher_.Detach(&states_);
+  states_ = std::move(other.states_);
+  state_index_ = std::move(other.state_index_);
+  counters_ = other.counters_;
+  timing_enabled_ = other.timing_enabled_;
+  max_retained_states_ = other.max_retained_states_;
+  publisher_ = std::move(other.publisher_);
+  return *this;
+}
 
-template<class HashableState>
-size_t HashManager<HashableState>::Size() const {
-  return state_to_state_id_.size();
+template<class HashableState, class StateIndex, class Allocator>
+HashManager<HashableState, StateIndex, Allocator>::~HashManager() {
+  publisher_.Detach(&states_);
 }
 
-template<class HashableState>
-bool HashManager<HashableState>::Exists(const HashableState &hashable_state)
+template<class HashableState, class StateIndex, class Allocator>
+size_t HashManager<HashableState, StateIndex, Allocator>::Size() const {
+  return states_.Size();
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+unsigned int HashManager<HashableState, StateIndex, Allocator>::FindStateID(
+  const HashableState &hashable_state, size_t hash) const {
+  size_t num_comparisons = 0;
+  const unsigned int found_state_id = state_index_.Find(hash,
+  [&](unsigned int state_id) {
+    ++num_comparisons;
+    return states_.Get(state_id) == hashable_state;
+  });
+  counters_.num_lookups.Add(1);
+  counters_.num_hits.Add(found_state_id != kInvalidStateID);
+  counters_.num_comparisons.Add(num_comparisons);
+  return found_state_id;
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+unsigned int HashManager<HashableState, StateIndex, Allocator>::FindOrIndexState(
+  const HashableState &hashable_state, size_t hash, unsigned int new_state_id) {
+  size_t num_comparisons = 0;
+  const unsigned int found_state_id = state_index_.FindOrInsert(hash,
+  [&](unsigned int state_id) {
+    ++num_comparisons;
+    return states_.Get(state_id) == hashable_state;
+  }, new_state_id);
+  const bool hit = found_state_id != new_state_id;
+  counters_.num_lookups.Add(1);
+  counters_.num_hits.Add(hit);
+  counters_.num_inserts.Add(!hit);
+  counters_.num_comparisons.Add(num_comparisons);
+  return found_state_id;
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+unsigned int HashManager<HashableState, StateIndex, Allocator>::IndexStoredState(
+  unsigned int new_state_id, size_t hash) {
+  unsigned int state_id = kInvalidStateID;
+
+  try {
+    state_id = FindOrIndexState(states_.Get(new_state_id), hash, new_state_id);
+  } catch (...) {
+    states_.Erase(new_state_id);
+    throw;
+  }
+
+  if (state_id != new_state_id) {
+    states_.Erase(new_state_id);
+  }
+
+  return state_id;
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+template<typename... Args>
+unsigned int HashManager<HashableState, StateIndex, Allocator>::StoreNewState(
+  size_t hash, Args &&... args) {
+  const unsigned int new_state_id = states_.NextFreeID();
+  states_.Emplace(new_state_id, std::forward<Args>(args)...);
+
+  try {
+    state_index_.Insert(hash, new_state_id);
+  } catch (...) {
+    states_.Erase(new_state_id);
+    throw;
+  }
+
+  counters_.num_inserts.Add(1);
+  return new_state_id;
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+bool HashManager<HashableState, StateIndex, Allocator>::Exists(const HashableState &hashable_state)
 const {
-  return state_to_state_id_.find(hashable_state) != state_to_state_id_.end();
+  internal::StatsTimer timer(timing_enabled_, counters_.lookup_time_ns);
+  return FindStateID(hashable_state, hashable_state.GetHash()) !=
+         kInvalidStateID;
 }
 
-template<class HashableState>
-bool HashManager<HashableState>::Exists(unsigned int state_id) const {
-  return state_id_to_state_.find(state_id) != state_id_to_state_.end();
+template<class HashableState, class StateIndex, class Allocator>
+bool HashManager<HashableState, StateIndex, Allocator>::Exists(unsigned int state_id) const {
+  return states_.Exists(state_id);
 }
 
-template<class HashableState>
-unsigned int HashManager<HashableState>::GetStateID(const HashableState
+template<class HashableState, class StateIndex, class Allocator>
+unsigned int HashManager<HashableState, StateIndex, Allocator>::GetStateID(const HashableState
                                                     &hashable_state) const {
-  const auto it = state_to_state_id_.find(hashable_state);
+  internal::StatsTimer timer(timing_enabled_, counters_.lookup_time_ns);
+  const unsigned int state_id = FindStateID(hashable_state,
+                                            hashable_state.GetHash());
 
-  if (it == state_to_state_id_.end()) {
+  if (state_id == kInvalidStateID) {
     std::ostringstream ss;
     ss << "Asked for non-existent state: " << std::endl << hashable_state <<
        std::endl;
-    Print();
+    Print(std::cout, kMaxStatesPrintedOnError);
     throw std::runtime_error(ss.str());
   }
 
-  return it->second;
+  return state_id;
 }
 
-template<class HashableState>
-const HashableState &HashManager<HashableState>::GetState(
+template<class HashableState, class StateIndex, class Allocator>
+const HashableState &HashManager<HashableState, StateIndex, Allocator>::GetState(
   unsigned int state_id) const {
-  const auto it = state_id_to_state_.find(state_id);
+  const HashableState *hashable_state = states_.Find(state_id);
 
-  if (it == state_id_to_state_.end()) {
+  if (hashable_state == nullptr) {
     std::ostringstream ss;
     ss << "Asked for non-existent state ID: " <<  state_id << std::endl;
-    Print();
+    Print(std::cout, kMaxStatesPrintedOnError);
     throw std::runtime_error(ss.str());
   }
 
-  return it->second;
+  return *hashable_state;
 }
 
 // Non-const methods
-template<class HashableState>
-unsigned int HashManager<HashableState>::GetStateIDForceful(
+template<class HashableState, class StateIndex, class Allocator>
+unsigned int HashManager<HashableState, StateIndex, Allocator>::GetStateIDForceful(
   const HashableState &hashable_state) {
-  const auto it = state_to_state_id_.find(hashable_state);
+  internal::StatsTimer timer(timing_enabled_, counters_.lookup_time_ns);
+  const size_t hash = hashable_state.GetHash();
+  unsigned int state_id = FindStateID(hashable_state, hash);
 
-  if (it != state_to_state_id_.end()) {
-    return it->second;
+  if (state_id == kInvalidStateID) {
+    state_id = StoreNewState(hash, hashable_state);
+    publisher_.Publish(states_);
   }
 
-  const int new_state_id = Size();
-  state_to_state_id_[hashable_state] = new_state_id;
-  state_id_to_state_.insert(std::make_pair(new_state_id, hashable_state));
-  return new_state_id;
+  return state_id;
 }
 
-template<class HashableState>
-void HashManager<HashableState>::UpdateState(const HashableState
-                                             &hashable_state) {
-  const auto it = state_to_state_id_.find(hashable_state);
+template<class HashableState, class StateIndex, class Allocator>
+unsigned int HashManager<HashableState, StateIndex, Allocator>::GetStateIDForceful(
+  HashableState &&hashable_state) {
+  internal::StatsTimer timer(timing_enabled_, counters_.lookup_time_ns);
+  const size_t hash = hashable_state.GetHash();
+  unsigned int state_id = FindStateID(hashable_state, hash);
+
+  if (state_id == kInvalidStateID) {
+    state_id = StoreNewState(hash, std::move(hashable_state));
+    publisher_.Publish(states_);
+  }
+
+  return state_id;
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+template<typename... Args>
+unsigned int HashManager<HashableState, StateIndex, Allocator>::EmplaceState(
+  Args &&... args) {
+  internal::StatsTimer timer(timing_enabled_, counters_.lookup_time_ns);
+  const unsigned int new_state_id = states_.NextFreeID();
+  const HashableState &hashable_state = states_.Emplace(new_state_id,
+                                                        std::forward<Args>(args)...);
+  const unsigned int state_id = IndexStoredState(new_state_id,
+                                                 hashable_state.GetHash());
+
+  if (state_id == new_state_id) {
+    publisher_.Publish(states_);
+  }
+
+  return state_id;
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+void HashManager<HashableState, StateIndex, Allocator>::GetStateIDsForceful(
+  const HashableState *hashable_states, size_t num_states,
+  unsigned int *state_ids) {
+  internal::StatsTimer timer(timing_enabled_, counters_.lookup_time_ns);
+  // Large enough to cover the latency of a cache miss, small enough for the
+  // prefetched lines to still be around when they are used.
+  constexpr size_t kBatchSize = 16;
+  size_t hashes[kBatchSize];
+
+  try {
+    for (size_t begin = 0; begin < num_states; begin += kBatchSize) {
+      const size_t end = std::min(num_states, begin + kBatchSize);
+
+      for (size_t ii = begin; ii < end; ++ii) {
+        hashes[ii - begin] = hashable_states[ii].GetHash();
+        state_index_.Prefetch(hashes[ii - begin]);
+      }
+
+      // Only states that are not found are copied.
+      for (size_t ii = begin; ii < end; ++ii) {
+        state_ids[ii] = FindStateID(hashable_states[ii], hashes[ii - begin]);
+
+        if (state_ids[ii] == kInvalidStateID) {
+          state_ids[ii] = StoreNewState(hashes[ii - begin], hashable_states[ii]);
+        }
+      }
+    }
+  } catch (...) {
+    // The states inserted before the failure stay, and must be visible.
+    publisher_.Publish(states_);
+    throw;
+  }
+
+  publisher_.Publish(states_);
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+void HashManager<HashableState, StateIndex, Allocator>::GetStateIDsForceful(
+  const std::vector<HashableState> &hashable_states,
+  std::vector<unsigned int> *state_ids) {
+  state_ids->resize(hashable_states.size());
+  GetStateIDsForceful(hashable_states.data(), hashable_states.size(),
+                      state_ids->data());
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+unsigned int HashManager<HashableState, StateIndex, Allocator>::GetStateIDForUpdate(
+  const HashableState &hashable_state) const {
+  const unsigned int state_id = FindStateID(hashable_state,
+                                            hashable_state.GetHash());
 
-  if (it == state_to_state_id_.end()) {
+  if (state_id == kInvalidStateID) {
     std::ostringstream ss;
     ss << "Asked to update a non-existent state " << std::endl << hashable_state <<
        std::endl;
-    Print();
+    Print(std::cout, kMaxStatesPrintedOnError);
     throw std::runtime_error(ss.str());
   }
 
-  const unsigned int old_state_id = it->second;
+  return state_id;
+}
 
-  state_to_state_id_.erase(it);
-  state_to_state_id_[hashable_state] = old_state_id;
+template<class HashableState, class StateIndex, class Allocator>
+void HashManager<HashableState, StateIndex, Allocator>::UpdateState(const HashableState
+                                                         &hashable_state) {
+  // Equal states hash equally, so the index entry stays valid.
+  *states_.Find(GetStateIDForUpdate(hashable_state)) = hashable_state;
+}
 
-  auto state_id_to_state_iterator = state_id_to_state_.find(old_state_id);
-  state_id_to_state_iterator->second = hashable_state;
+template<class HashableState, class StateIndex, class Allocator>
+void HashManager<HashableState, StateIndex, Allocator>::UpdateState(
+  HashableState &&hashable_state) {
+  *states_.Find(GetStateIDForUpdate(hashable_state)) = std::move(hashable_state);
 }
 
-template<class HashableState>
-void HashManager<HashableState>::InsertState(const HashableState
+template<class HashableState, class StateIndex, class Allocator>
+template<typename Function>
+void HashManager<HashableState, StateIndex, Allocator>::ModifyState(unsigned int state_id,
+                                                         Function fn) {
+  HashableState *hashable_state = states_.Find(state_id);
+
+  if (hashable_state == nullptr) {
+    std::ostringstream ss;
+    ss << "Asked to modify a non-existent state ID: " << state_id << std::endl;
+    Print(std::cout, kMaxStatesPrintedOnError);
+    throw std::runtime_error(ss.str());
+  }
+
+  fn(*hashable_state);
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+void HashManager<HashableState, StateIndex, Allocator>::InsertState(const HashableState
                                              &hashable_state, int state_id) {
-  const auto it = state_to_state_id_.find(hashable_state);
+  const size_t hash = hashable_state.GetHash();
 
-  if (it != state_to_state_id_.end()) {
+  if (FindStateID(hashable_state, hash) != kInvalidStateID) {
     std::ostringstream ss;
     ss << "Asked to insert an already existent state " << std::endl <<
        hashable_state << std::endl;
-    Print();
+    Print(std::cout, kMaxStatesPrintedOnError);
+    throw std::runtime_error(ss.str());
+  }
+
+  if (states_.Exists(state_id)) {
+    std::ostringstream ss;
+    ss << "Asked to insert a state with an already used state ID: " << state_id
+       << std::endl;
     throw std::runtime_error(ss.str());
   }
 
-  state_to_state_id_[hashable_state] = state_id;
-  state_id_to_state_.insert(std::make_pair(state_id, hashable_state));
+  states_.Emplace(state_id, hashable_state);
+  state_index_.Insert(hash, state_id);
+  counters_.num_inserts.Add(1);
+  publisher_.Publish(states_);
 }
 
-template<class HashableState>
-void HashManager<HashableState>::Reset() {
-  state_to_state_id_.clear();
-  state_id_to_state_.clear();
+template<class HashableState, class StateIndex, class Allocator>
+void HashManager<HashableState, StateIndex, Allocator>::Reset() {
+  const bool release_memory = Size() > max_retained_states_;
+  // Observed states are retired rather than released or reused in place.
+  const bool states_retired = publisher_.RetireStates(&states_);
+
+  if (release_memory) {
+    state_index_.Clear();
+
+    if (!states_retired) {
+      states_.Clear();
+    }
+  } else {
+    state_index_.Recycle();
+
+    if (!states_retired) {
+      states_.Recycle();
+    }
+  }
 }
 
-template<class HashableState>
-void HashManager<HashableState>::Print() const {
-  std::cout << std::right << std::setfill('*')
-            << std::setw(50) << "Begin Hash Table" << std::endl;
+template<class HashableState, class StateIndex, class Allocator>
+template<typename Predicate>
+StateIDRemap HashManager<HashableState, StateIndex, Allocator>::Compact(
+  Predicate keep) {
+  std::vector<unsigned int> live_state_ids;
+  states_.ForEach([&](unsigned int state_id, const HashableState & state) {
+    if (keep(state_id, state)) {
+      live_state_ids.push_back(state_id);
+    }
+  });
+
+  // Only sparse IDs are visited out of order.
+  if (!std::is_sorted(live_state_ids.begin(), live_state_ids.end())) {
+    std::sort(live_state_ids.begin(), live_state_ids.end());
+  }
+
+  StateIDRemap remap;
+  StateStore<HashableState, Allocator> live_states(
+    states_.GetAllocator());
+  state_index_.Clear();
+  state_index_.Reserve(live_state_ids.size());
+
+  for (const unsigned int state_id : live_state_ids) {
+    const unsigned int new_state_id = remap.Add(state_id);
+    HashableState &state = *states_.Find(state_id);
+    // Observers may still be reading the old states, so those are copied.
+    const HashableState &new_state = publisher_.IsActive() ?
+                                     live_states.Emplace(new_state_id, state) :
+                                     live_states.Emplace(new_state_id, std::move(state));
+    state_index_.Insert(new_state.GetHash(), new_state_id);
+  }
+
+  if (!publisher_.RetireStates(&states_)) {
+    states_.Clear();
+  }
+
+  states_ = std::move(live_states);
+  publisher_.Publish(states_);
+  return remap;
+}
 
-  for (const auto &entry : state_to_state_id_) {
-    std::cout << "State ID: " << entry.second << std::endl;
-    std::cout << entry.first << std::endl;
-    std::cout << std::string(10, '-') << std::endl;
+template<class HashableState, class StateIndex, class Allocator>
+StateIDRemap HashManager<HashableState, StateIndex, Allocator>::Compact(
+  const std::vector<unsigned int> &live_state_ids) {
+  std::vector<unsigned int> sorted_state_ids(live_state_ids);
+  std::sort(sorted_state_ids.begin(), sorted_state_ids.end());
+
+  for (const unsigned int state_id : sorted_state_ids) {
+    if (!states_.Exists(state_id)) {
+      std::ostringstream ss;
+      ss << "Asked to keep a non-existent state ID: " << state_id << std::endl;
+      throw std::runtime_error(ss.str());
+    }
   }
 
-  std::cout << std::right << std::setfill('*')
-            << std::setw(50) << "End Hash Table" << std::endl;
+  return Compact([&](unsigned int state_id, const HashableState &) {
+    return std::binary_search(sorted_state_ids.begin(), sorted_state_ids.end(),
+                              state_id);
+  });
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+void HashManager<HashableState, StateIndex, Allocator>::LoadSnapshot(
+  const StateSnapshot<HashableState> &snapshot) {
+  Reset();
+  state_index_.Reserve(snapshot.Size());
+
+  for (size_t ii = 0; ii < snapshot.Size(); ++ii) {
+    states_.Emplace(snapshot.StateID(ii), snapshot.State(ii));
+    state_index_.Insert(snapshot.Hash(ii), snapshot.StateID(ii));
+  }
+
+  counters_.num_inserts.Add(snapshot.Size());
+  publisher_.Publish(states_);
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+void HashManager<HashableState, StateIndex, Allocator>::Print() const {
+  Print(std::cout, Size());
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+void HashManager<HashableState, StateIndex, Allocator>::Print(std::ostream &stream,
+                                                   size_t max_states) const {
+  internal::PrintStates(stream, states_, max_states);
+}
+
+template<class HashableState, class StateIndex, class Allocator>
+HashManagerStats HashManager<HashableState, StateIndex, Allocator>::GetStats() const {
+  HashManagerStats stats;
+  stats.num_states = Size();
+  stats.bytes_used = states_.MemoryBytes() + state_index_.MemoryBytes();
+  stats.load_factor = state_index_.LoadFactor();
+  stats.num_inserts = counters_.num_inserts.Get();
+  stats.num_lookups = counters_.num_lookups.Get();
+  stats.num_hits = counters_.num_hits.Get();
+  stats.num_comparisons = counters_.num_comparisons.Get();
+  stats.lookup_time_ns = counters_.lookup_time_ns.Get();
+  return stats;
 }
 }  // namespace sbpl_utils
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace sbpl_utils {
+
+// Snapshot of a HashManager's size and usage counters (see
+// HashManager::GetStats()). Counters accumulate from construction, or from the
+// last HashManager::ResetStats(), across calls to Reset().
+struct HashManagerStats {
+  size_t num_states = 0;
+  // Heap memory held by the state storage and the hash index, including
+  // reserved but unused capacity.
+  size_t bytes_used = 0;
+  // Fraction of the index's buckets (chained) or slots (open addressing) in
+  // use.
+  double load_factor = 0.0;
+
+  // States added to the hash manager.
+  uint64_t num_inserts = 0;
+  // State to ID queries, including the ones made by forceful insertions, and
+  // how many of them found an existing state.
+  uint64_t num_lookups = 0;
+  uint64_t num_hits = 0;
+  // Calls to HashableState::operator== made by lookups, i.e. the total probe
+  // length.
+  uint64_t num_comparisons = 0;
+  // Wall time spent in lookups and insertions. Only measured while timing is
+  // enabled (see HashManager::EnableTiming()).
+  uint64_t lookup_time_ns = 0;
+
+  double HitRate() const {
+    return num_lookups == 0 ? 0.0 : static_cast<double>(num_hits) / num_lookups;
+  }
+  double MeanProbeLength() const {
+    return num_lookups == 0 ? 0.0 : static_cast<double>(num_comparisons) /
+           num_lookups;
+  }
+
+  // Single-line JSON object with all fields.
+  std::string ToJson() const;
+};
+
+inline std::string HashManagerStats::ToJson() const {
+  std::ostringstream ss;
+  ss << "{\"num_states\": " << num_states
+     << ", \"bytes_used\": " << bytes_used
+     << ", \"load_factor\": " << load_factor
+     << ", \"num_inserts\": " << num_inserts
+     << ", \"num_lookups\": " << num_lookups
+     << ", \"num_hits\": " << num_hits
+     << ", \"num_comparisons\": " << num_comparisons
+     << ", \"hit_rate\": " << HitRate()
+     << ", \"mean_probe_length\": " << MeanProbeLength()
+     << ", \"lookup_time_ns\": " << lookup_time_ns << "}";
+  return ss.str();
+}
+
+inline std::ostream &operator<< (std::ostream &stream,
+                                 const HashManagerStats &stats) {
+  stream << stats.ToJson();
+  return stream;
+}
+
+namespace internal {
+// Counter that const methods can bump. Increments are a relaxed load and
+// store rather than an atomic read-modify-write, so they cost the same as a
+// plain increment; concurrent readers of a shared const HashManager may lose
+// counts, but never race.
+class StatsCounter {
+ public:
+  StatsCounter() : value_(0) {}
+  StatsCounter(const StatsCounter &other) : value_(other.Get()) {}
+  StatsCounter &operator=(const StatsCounter &other) {
+    value_.store(other.Get(), std::memory_order_relaxed);
+    return *this;
+  }
+
+  void Add(uint64_t amount) const {
+    value_.store(value_.load(std::memory_order_relaxed) + amount,
+                 std::memory_order_relaxed);
+  }
+  uint64_t Get() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  mutable std::atomic<uint64_t> value_;
+};
+
+struct HashManagerCounters {
+  StatsCounter num_inserts;
+  StatsCounter num_lookups;
+  StatsCounter num_hits;
+  StatsCounter num_comparisons;
+  StatsCounter lookup_time_ns;
+};
+
+// Adds the lifetime of the timer to counter, if enabled.
+class StatsTimer {
+ public:
+  StatsTimer(bool enabled, const StatsCounter &counter) : counter_(enabled ?
+                                                                     &counter : nullptr) {
+    if (counter_ != nullptr) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+  ~StatsTimer() {
+    if (counter_ != nullptr) {
+      counter_->Add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>
+                                          (std::chrono::steady_clock::now() - start_).count()));
+    }
+  }
+
+  StatsTimer(const StatsTimer &) = delete;
+  StatsTimer &operator=(const StatsTimer &) = delete;
+
+ private:
+  const StatsCounter *counter_;
+  std::chrono::steady_clock::time_point start_;
+};
+}  // namespace internal
+}  // namespace sbpl_utils
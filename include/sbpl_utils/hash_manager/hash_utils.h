@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace sbpl_utils {
+
+// Hashing helpers for implementing HashableState::GetHash().
+//
+// Combining coordinates with XOR (e.g. x ^ y) is symmetric, maps every
+// diagonal cell to 0 and makes all permutations of a vector collide. Use
+// HashValues or HashCombine instead, e.g.
+//      size_t StateXY::GetHash() const {
+//        return HashValues(x_, y_);
+//      }
+// All helpers are constexpr, so hashes of constant states can be computed at
+// compile time.
+
+namespace internal {
+constexpr uint64_t XorShiftRight(uint64_t value, unsigned int shift) {
+  return value ^ (value >> shift);
+}
+}  // namespace internal
+
+// Bijective 64-bit mixing function (the SplitMix64 finalizer): every input bit
+// affects every output bit.
+constexpr uint64_t HashMix(uint64_t value) {
+  return internal::XorShiftRight(internal::XorShiftRight(internal::XorShiftRight(
+                                                           value, 30) * 0xBF58476D1CE4E5B9ull, 27) * 0x94D049BB133111EBull, 31);
+}
+
+// Order-dependent combination of a running hash with one more value.
+constexpr size_t HashCombine(size_t seed, uint64_t value) {
+  return static_cast<size_t>(HashMix(static_cast<uint64_t>(seed) * 0x9E3779B97F4A7C15ull
+                                     + value));
+}
+
+namespace internal {
+constexpr size_t HashFold(size_t seed) {
+  return seed;
+}
+
+template <typename T, typename... Rest>
+constexpr size_t HashFold(size_t seed, T value, Rest... rest) {
+  return HashFold(HashCombine(seed, static_cast<uint64_t>(value)), rest...);
+}
+}  // namespace internal
+
+// Hash of a sequence of integral values, e.g. HashValues(x, y, theta).
+template <typename... Ts>
+constexpr size_t HashValues(Ts... values) {
+  return internal::HashFold(0, values...);
+}
+
+// Hash of a block of raw bytes, e.g. a packed array of coordinates. Only use
+// this for types without padding, where equal values have equal bytes.
+inline size_t HashBytes(const void *data, size_t num_bytes) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  size_t hash_value = num_bytes;
+
+  for (; num_bytes >= sizeof(uint64_t); num_bytes -= sizeof(uint64_t),
+       bytes += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    hash_value = HashCombine(hash_value, word);
+  }
+
+  if (num_bytes > 0) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes, num_bytes);
+    hash_value = HashCombine(hash_value, word);
+  }
+
+  return hash_value;
+}
+
+// Hash-quality report for the index of a loaded HashManager (see
+// HashManager::GetHashDiagnostics()).
+struct HashDiagnostics {
+  size_t num_states = 0;
+  // Buckets for chained indices, slots for open-addressing ones.
+  size_t num_buckets = 0;
+  size_t num_occupied_buckets = 0;
+  // Longest chain (chained indices) or probe sequence in groups
+  // (open-addressing indices), and its mean over all states.
+  size_t max_probe_length = 0;
+  double mean_probe_length = 0.0;
+  // States whose full hash value is shared with at least one other state.
+  // These can only be told apart by operator==, regardless of table size.
+  size_t num_colliding_states = 0;
+
+  double BucketOccupancy() const {
+    return num_buckets == 0 ? 0.0 : static_cast<double>(num_occupied_buckets) /
+           num_buckets;
+  }
+  double CollisionRate() const {
+    return num_states == 0 ? 0.0 : static_cast<double>(num_colliding_states) /
+           num_states;
+  }
+};
+
+namespace internal {
+// Number of entries in hashes whose value occurs more than once.
+inline size_t CountCollidingHashes(std::vector<size_t> hashes) {
+  std::sort(hashes.begin(), hashes.end());
+  size_t num_colliding = 0;
+
+  for (size_t begin = 0, end = 0; begin < hashes.size(); begin = end) {
+    while (end < hashes.size() && hashes[end] == hashes[begin]) {
+      ++end;
+    }
+
+    if (end - begin > 1) {
+      num_colliding += end - begin;
+    }
+  }
+
+  return num_colliding;
+}
+}  // namespace internal
+
+inline std::ostream &operator<< (std::ostream &stream,
+                                 const HashDiagnostics &diagnostics) {
+  stream << "states: " << diagnostics.num_states
+         << ", buckets: " << diagnostics.num_buckets
+         << ", bucket occupancy: " << diagnostics.BucketOccupancy()
+         << ", max probe length: " << diagnostics.max_probe_length
+         << ", mean probe length: " << diagnostics.mean_probe_length
+         << ", collision rate: " << diagnostics.CollisionRate();
+  return stream;
+}
+}  // namespace sbpl_utils
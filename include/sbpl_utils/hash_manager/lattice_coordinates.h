@@ -0,0 +1,18 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+namespace sbpl_utils {
+
+// Traits that expose the discrete coordinates of a state on a bounded lattice,
+// for use with DenseGridHashManager. Specializations must provide
+//      static constexpr size_t kDimensions;
+//      static std::array<int, kDimensions> Get(const HashableState &state);
+// where two states are equal exactly when their coordinates are equal.
+//
+// There is no generic implementation: a state type can only be used with
+// DenseGridHashManager once it specializes LatticeCoordinates.
+template <class HashableState>
+struct LatticeCoordinates;
+}  // namespace sbpl_utils
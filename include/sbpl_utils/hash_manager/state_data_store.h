@@ -0,0 +1,195 @@
+#pragma once
+
+#include <sbpl_utils/hash_manager/state_id_remap.h>
+#include <sbpl_utils/hash_manager/state_store.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace sbpl_utils {
+
+// Struct-of-arrays store for per-state planner data (g-values, parents, best
+// actions, ...) indexed by HashManager state IDs. Each column is a contiguous
+// std::vector, so search loops that only read g-values or flags touch small
+// dense arrays rather than the states themselves, and updating a g-value never
+// copies or rehashes a state (as HashManager::UpdateState would).
+//
+// Columns are addressed by index, e.g.
+//      StateDataStore<int, unsigned int> data(kInfiniteG, kInvalidStateID);
+//      data.EnsureRow(state_id);
+//      data.Get<0>(state_id) = g;
+//      data.Get<1>(state_id) = parent_id;
+// See SearchDataStore below for a preset with named accessors.
+//
+// Rows are added on demand: call EnsureRow() for every new state ID (or
+// Resize(hash_manager.Size()) after interning a batch), and new rows are
+// filled with the default value of each column.
+template <typename... Columns>
+class StateDataStore {
+ public:
+  static constexpr size_t kNumColumns = sizeof...(Columns);
+
+  template <size_t I>
+  using ColumnType = typename std::tuple_element<I, std::tuple<Columns...>>::type;
+
+  // Rows are value-initialized.
+  StateDataStore() = default;
+  // New rows take the given value in each column.
+  explicit StateDataStore(const Columns &... default_values) : defaults_(
+      default_values...) {}
+
+  // Number of rows, i.e. one more than the largest state ID covered.
+  size_t Size() const {
+    return std::get<0>(columns_).size();
+  }
+
+  // Grows or shrinks every column to num_rows rows.
+  void Resize(size_t num_rows) {
+    ResizeColumns(num_rows);
+  }
+
+  // Makes sure a row exists for state_id. Amortized O(1).
+  void EnsureRow(unsigned int state_id) {
+    if (state_id >= Size()) {
+      ResizeColumns(state_id + 1);
+    }
+  }
+
+  // Unchecked access: the row must exist. (A reference proxy for bool
+  // columns.)
+  template <size_t I>
+  typename std::vector<ColumnType<I>>::reference Get(unsigned int state_id) {
+    return std::get<I>(columns_)[state_id];
+  }
+  template <size_t I>
+  typename std::vector<ColumnType<I>>::const_reference Get(
+    unsigned int state_id) const {
+    return std::get<I>(columns_)[state_id];
+  }
+
+  // The whole column, e.g. for scanning or resetting it in one pass.
+  template <size_t I>
+  std::vector<ColumnType<I>> &Column() {
+    return std::get<I>(columns_);
+  }
+  template <size_t I>
+  const std::vector<ColumnType<I>> &Column() const {
+    return std::get<I>(columns_);
+  }
+
+  // Sets every row back to the default values, keeping the rows and memory,
+  // e.g. between planning queries on the same hash manager.
+  void ResetRows() {
+    ResetColumns();
+  }
+
+  // Removes all rows, keeping the memory.
+  void Clear() {
+    ResizeColumns(0);
+  }
+
+  // Moves every row to the new ID of its state after HashManager::Compact(),
+  // dropping the rows of dropped states. Values that are themselves state
+  // IDs are not translated (but see SearchDataStore::ApplyRemap()).
+  void ApplyRemap(const StateIDRemap &remap) {
+    RemapColumns(remap);
+  }
+
+ private:
+  // Column-by-column recursion over the tuples.
+  template <size_t I = 0>
+  typename std::enable_if<(I == kNumColumns)>::type ResizeColumns(size_t) {}
+  template <size_t I = 0>
+  typename std::enable_if<(I < kNumColumns)>::type ResizeColumns(
+    size_t num_rows) {
+    std::get<I>(columns_).resize(num_rows, std::get<I>(defaults_));
+    ResizeColumns<I + 1>(num_rows);
+  }
+
+  template <size_t I = 0>
+  typename std::enable_if<(I == kNumColumns)>::type RemapColumns(
+    const StateIDRemap &) {}
+  template <size_t I = 0>
+  typename std::enable_if<(I < kNumColumns)>::type RemapColumns(
+    const StateIDRemap &remap) {
+    remap.Apply(&std::get<I>(columns_), std::get<I>(defaults_));
+    RemapColumns<I + 1>(remap);
+  }
+
+  template <size_t I = 0>
+  typename std::enable_if<(I == kNumColumns)>::type ResetColumns() {}
+  template <size_t I = 0>
+  typename std::enable_if<(I < kNumColumns)>::type ResetColumns() {
+    std::vector<ColumnType<I>> &column = std::get<I>(columns_);
+    column.assign(column.size(), std::get<I>(defaults_));
+    ResetColumns<I + 1>();
+  }
+
+  std::tuple<std::vector<Columns>...> columns_;
+  std::tuple<Columns...> defaults_;
+};
+
+// g-value of states that have not been reached.
+constexpr int kInfiniteG = std::numeric_limits<int>::max();
+
+// Per-state data of a typical best-first search: g-value, parent state ID,
+// best action (the index of the action that reached the state from its
+// parent) and open/closed flags.
+class SearchDataStore : public StateDataStore<int, unsigned int, int, uint8_t> {
+ public:
+  enum Flags : uint8_t {
+    kOpen = 1 << 0,
+    kClosed = 1 << 1,
+  };
+
+  SearchDataStore() : StateDataStore(kInfiniteG, kInvalidStateID, -1, 0) {}
+
+  int &g(unsigned int state_id) {
+    return Get<0>(state_id);
+  }
+  int g(unsigned int state_id) const {
+    return Get<0>(state_id);
+  }
+  unsigned int &parent(unsigned int state_id) {
+    return Get<1>(state_id);
+  }
+  unsigned int parent(unsigned int state_id) const {
+    return Get<1>(state_id);
+  }
+  int &best_action(unsigned int state_id) {
+    return Get<2>(state_id);
+  }
+  int best_action(unsigned int state_id) const {
+    return Get<2>(state_id);
+  }
+  uint8_t &flags(unsigned int state_id) {
+    return Get<3>(state_id);
+  }
+  uint8_t flags(unsigned int state_id) const {
+    return Get<3>(state_id);
+  }
+
+  // Like StateDataStore::ApplyRemap(), and also translates parent IDs.
+  // Parents that were dropped become kInvalidStateID.
+  void ApplyRemap(const StateIDRemap &remap) {
+    StateDataStore::ApplyRemap(remap);
+
+    for (unsigned int &parent_id : Column<1>()) {
+      if (parent_id != kInvalidStateID) {
+        parent_id = remap[parent_id];
+      }
+    }
+  }
+
+  bool IsOpen(unsigned int state_id) const {
+    return (flags(state_id) & kOpen) != 0;
+  }
+  bool IsClosed(unsigned int state_id) const {
+    return (flags(state_id) & kClosed) != 0;
+  }
+};
+}  // namespace sbpl_utils
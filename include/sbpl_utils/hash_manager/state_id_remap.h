@@ -0,0 +1,101 @@
+#pragma once
+
+#include <sbpl_utils/hash_manager/state_store.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sbpl_utils {
+
+// Old to new state ID mapping produced by HashManager::Compact(). Surviving
+// states are renumbered 0..NumStates()-1 in the order of their old IDs;
+// dropped (or never used) IDs map to kInvalidStateID.
+//
+// Callers apply the remap to their own ID-indexed data, e.g.
+//      const StateIDRemap remap = hash_manager.Compact(is_live);
+//      remap.Apply(&heuristic_values);
+//      search_data.ApplyRemap(remap);
+// and translate any state IDs they keep elsewhere with remap[old_state_id].
+class StateIDRemap {
+ public:
+  StateIDRemap() = default;
+
+  // Records that the state old_state_id survives, taking the next new ID.
+  // Called in increasing order of old IDs.
+  unsigned int Add(unsigned int old_state_id) {
+    const unsigned int new_state_id = static_cast<unsigned int>(num_states_++);
+
+    // IDs are mostly dense; far outliers (see StateStore) go to a map so
+    // that they do not blow up the table.
+    if (old_state_id < 2 * dense_.size() + kMinDenseSize) {
+      if (old_state_id >= dense_.size()) {
+        dense_.resize(old_state_id + 1, kInvalidStateID);
+      }
+
+      dense_[old_state_id] = new_state_id;
+    } else {
+      sparse_.emplace(old_state_id, new_state_id);
+    }
+
+    return new_state_id;
+  }
+
+  // New ID of a state, or kInvalidStateID if it was dropped.
+  unsigned int operator[](unsigned int old_state_id) const {
+    if (old_state_id < dense_.size()) {
+      return dense_[old_state_id];
+    }
+
+    const auto it = sparse_.find(old_state_id);
+    return it == sparse_.end() ? kInvalidStateID : it->second;
+  }
+
+  // Number of surviving states.
+  size_t NumStates() const {
+    return num_states_;
+  }
+
+  // Rearranges values indexed by old state ID to be indexed by new state ID,
+  // dropping the values of dropped states. The result has NumStates()
+  // entries; surviving states beyond the end of values get missing_value.
+  template <typename T, typename VectorAllocator>
+  void Apply(std::vector<T, VectorAllocator> *values,
+             const T &missing_value = T()) const;
+
+ private:
+  static constexpr size_t kMinDenseSize = 1024;
+
+  std::vector<unsigned int> dense_;
+  std::unordered_map<unsigned int, unsigned int> sparse_;
+  size_t num_states_ = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Template Inline Implementation
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename T, typename VectorAllocator>
+void StateIDRemap::Apply(std::vector<T, VectorAllocator> *values,
+                         const T &missing_value) const {
+  std::vector<T, VectorAllocator> new_values(num_states_, missing_value,
+                                             values->get_allocator());
+  const size_t num_dense = std::min(dense_.size(), values->size());
+
+  for (size_t old_state_id = 0; old_state_id < num_dense; ++old_state_id) {
+    if (dense_[old_state_id] != kInvalidStateID) {
+      new_values[dense_[old_state_id]] = std::move((*values)[old_state_id]);
+    }
+  }
+
+  for (const auto &entry : sparse_) {
+    if (entry.first < values->size()) {
+      new_values[entry.second] = std::move((*values)[entry.first]);
+    }
+  }
+
+  values->swap(new_values);
+}
+}  // namespace sbpl_utils
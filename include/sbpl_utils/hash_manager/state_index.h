@@ -0,0 +1,266 @@
+#pragma once
+
+#include <sbpl_utils/hash_manager/hash_utils.h>
+#include <sbpl_utils/hash_manager/state_store.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace sbpl_utils {
+
+// Hash index from states to state IDs that does not hold the states
+// themselves. The states live once, in the HashManager's StateStore, and the
+// index only records IDs. Lookups are heterogeneous: the caller provides the
+// hash of the probe state and an equality predicate that compares the probe
+// against the stored state with a given ID.
+//
+// Collisions are resolved by chaining, but chain links are kept in one
+// contiguous vector rather than in individually allocated nodes. Each entry
+// caches its state's hash, so growing the index never calls GetHash() again
+// and chain walks only invoke the equality predicate on full hash matches.
+//
+// Buckets are stamped with a generation, so Recycle() can empty the index in
+// O(1) while keeping its memory: buckets from an older generation read as
+// empty.
+//
+// All memory is obtained from Allocator (see HashManager). Use the
+// ChainedStateIndex alias for the default allocator.
+template <class Allocator = std::allocator<char>>
+class BasicChainedStateIndex {
+ public:
+  // The same index type with a different allocator.
+  template <class OtherAllocator>
+  using Rebind = BasicChainedStateIndex<OtherAllocator>;
+
+  explicit BasicChainedStateIndex(const Allocator &allocator = Allocator()) :
+    buckets_(BucketAllocator(allocator)), entries_(EntryAllocator(allocator)) {}
+
+  // Number of IDs in the index.
+  size_t Size() const {
+    return entries_.size();
+  }
+
+  // Returns the ID of the first entry with the given hash for which
+  // equal(state_id) holds, or kInvalidStateID if there is none.
+  template <typename Equal>
+  unsigned int Find(size_t hash, Equal equal) const;
+
+  // Adds state_id under the given hash. The caller guarantees that no equal
+  // state is already present.
+  void Insert(size_t hash, unsigned int state_id) {
+    FindOrInsert(hash, [](unsigned int) {
+      return false;
+    }, state_id);
+  }
+
+  // Single-probe combination of Find and Insert: returns the ID of the state
+  // for which equal(state_id) holds if there is one, otherwise adds
+  // new_state_id under hash and returns it.
+  template <typename Equal>
+  unsigned int FindOrInsert(size_t hash, Equal equal, unsigned int new_state_id);
+
+  // Hint that the bucket for hash is about to be looked up.
+  void Prefetch(size_t hash) const {
+    if (!buckets_.empty()) {
+      __builtin_prefetch(&buckets_[BucketFor(hash)]);
+    }
+  }
+
+  // Grows the index so that it holds num_states IDs without rehashing.
+  void Reserve(size_t num_states);
+
+  void Clear() {
+    // Swap with empty vectors to release the memory, too.
+    BucketVector(buckets_.get_allocator()).swap(buckets_);
+    EntryVector(entries_.get_allocator()).swap(entries_);
+    shift_ = 64;
+    generation_ = 0;
+  }
+
+  // Removes all IDs in O(1), keeping the memory for reuse.
+  void Recycle();
+
+  // Entries per bucket.
+  double LoadFactor() const {
+    return buckets_.empty() ? 0.0 : static_cast<double>(entries_.size()) /
+           buckets_.size();
+  }
+
+  // Heap memory held by the index, in bytes.
+  size_t MemoryBytes() const {
+    return buckets_.capacity() * sizeof(Bucket) + entries_.capacity() *
+           sizeof(Entry);
+  }
+
+  // Bucket occupancy, chain lengths and hash collisions.
+  HashDiagnostics Diagnostics() const;
+
+ private:
+  static constexpr unsigned int kMinBucketBits = 4;
+
+  struct Entry {
+    size_t hash;
+    unsigned int state_id;
+    unsigned int next;
+  };
+
+  struct Bucket {
+    // Index of the first entry in the bucket, or kInvalidStateID.
+    unsigned int head;
+    unsigned int generation;
+  };
+
+  typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Bucket>
+  BucketAllocator;
+  typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Entry>
+  EntryAllocator;
+  typedef std::vector<Bucket, BucketAllocator> BucketVector;
+  typedef std::vector<Entry, EntryAllocator> EntryVector;
+
+  // GetHash() implementations are often weak in the low bits, so spread them
+  // with a multiplicative (Fibonacci) hash before picking a bucket.
+  size_t BucketFor(size_t hash) const {
+    return static_cast<size_t>((static_cast<uint64_t>(hash) *
+                                0x9E3779B97F4A7C15ull) >> shift_);
+  }
+
+  // Index of the first entry in the bucket, or kInvalidStateID.
+  unsigned int Head(size_t bucket) const {
+    return buckets_[bucket].generation == generation_ ? buckets_[bucket].head :
+           kInvalidStateID;
+  }
+
+  void Rehash(unsigned int bucket_bits);
+
+  BucketVector buckets_;
+  EntryVector entries_;
+  unsigned int shift_ = 64;
+  unsigned int generation_ = 0;
+};
+
+typedef BasicChainedStateIndex<> ChainedStateIndex;
+
+///////////////////////////////////////////////////////////////////////////////
+// Template Inline Implementation
+///////////////////////////////////////////////////////////////////////////////
+
+template <class Allocator>
+template <typename Equal>
+unsigned int BasicChainedStateIndex<Allocator>::Find(size_t hash, Equal equal) const {
+  if (buckets_.empty()) {
+    return kInvalidStateID;
+  }
+
+  for (unsigned int entry = Head(BucketFor(hash)); entry != kInvalidStateID;
+       entry = entries_[entry].next) {
+    if (entries_[entry].hash == hash && equal(entries_[entry].state_id)) {
+      return entries_[entry].state_id;
+    }
+  }
+
+  return kInvalidStateID;
+}
+
+template <class Allocator>
+template <typename Equal>
+unsigned int BasicChainedStateIndex<Allocator>::FindOrInsert(size_t hash, Equal equal,
+                                             unsigned int new_state_id) {
+  // Grow up front, so that the bucket found by the probe is also the one to
+  // insert into.
+  if (entries_.size() >= buckets_.size()) {
+    const unsigned int bucket_bits = buckets_.empty() ? kMinBucketBits :
+                                     64 - shift_ + 1;
+    Rehash(bucket_bits);
+  }
+
+  const size_t bucket = BucketFor(hash);
+
+  for (unsigned int entry = Head(bucket); entry != kInvalidStateID;
+       entry = entries_[entry].next) {
+    if (entries_[entry].hash == hash && equal(entries_[entry].state_id)) {
+      return entries_[entry].state_id;
+    }
+  }
+
+  const Entry entry = {hash, new_state_id, Head(bucket)};
+  buckets_[bucket].head = static_cast<unsigned int>(entries_.size());
+  buckets_[bucket].generation = generation_;
+  entries_.push_back(entry);
+  return new_state_id;
+}
+
+template <class Allocator>
+void BasicChainedStateIndex<Allocator>::Rehash(unsigned int bucket_bits) {
+  shift_ = 64 - bucket_bits;
+  const Bucket empty_bucket = {kInvalidStateID, generation_};
+  buckets_.assign(size_t(1) << bucket_bits, empty_bucket);
+
+  for (unsigned int entry = 0; entry < entries_.size(); ++entry) {
+    const size_t bucket = BucketFor(entries_[entry].hash);
+    entries_[entry].next = buckets_[bucket].head;
+    buckets_[bucket].head = entry;
+  }
+}
+
+template <class Allocator>
+void BasicChainedStateIndex<Allocator>::Recycle() {
+  entries_.clear();
+
+  // Once the generation wraps around, stale buckets could pass for live ones.
+  if (++generation_ == 0) {
+    const Bucket empty_bucket = {kInvalidStateID, generation_};
+    std::fill(buckets_.begin(), buckets_.end(), empty_bucket);
+  }
+}
+
+template <class Allocator>
+void BasicChainedStateIndex<Allocator>::Reserve(size_t num_states) {
+  entries_.reserve(num_states);
+  unsigned int bucket_bits = kMinBucketBits;
+
+  while ((size_t(1) << bucket_bits) < num_states) {
+    ++bucket_bits;
+  }
+
+  if ((size_t(1) << bucket_bits) > buckets_.size()) {
+    Rehash(bucket_bits);
+  }
+}
+
+template <class Allocator>
+HashDiagnostics BasicChainedStateIndex<Allocator>::Diagnostics() const {
+  HashDiagnostics diagnostics;
+  diagnostics.num_states = entries_.size();
+  diagnostics.num_buckets = buckets_.size();
+  size_t total_probe_length = 0;
+
+  for (size_t bucket = 0; bucket < buckets_.size(); ++bucket) {
+    size_t chain_length = 0;
+
+    for (unsigned int entry = Head(bucket); entry != kInvalidStateID;
+         entry = entries_[entry].next) {
+      // Finding the k-th entry of a chain takes k steps.
+      total_probe_length += ++chain_length;
+    }
+
+    diagnostics.num_occupied_buckets += chain_length > 0;
+    diagnostics.max_probe_length = std::max(diagnostics.max_probe_length,
+                                            chain_length);
+  }
+
+  std::vector<size_t> hashes;
+  hashes.reserve(entries_.size());
+
+  for (const Entry &entry : entries_) {
+    hashes.push_back(entry.hash);
+  }
+
+  diagnostics.num_colliding_states = internal::CountCollidingHashes(hashes);
+  diagnostics.mean_probe_length = entries_.empty() ? 0.0 :
+                                  static_cast<double>(total_probe_length) / entries_.size();
+  return diagnostics;
+}
+}  // namespace sbpl_utils
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <sbpl_utils/common/epoch.h>
+#include <sbpl_utils/hash_manager/state_store.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace sbpl_utils {
+
+namespace internal {
+// State shared between a hash manager's StatePublisher and its observers.
+template <class HashableState>
+struct PublishedStates {
+  // Addresses of the published chunks of the hash manager's StateStore.
+  // Entries below the published number of states are never modified, so
+  // readers can use them without synchronizing with the writer.
+  struct Table {
+    Table(uint64_t table_version, size_t table_capacity) :
+      version(table_version), num_states(0), capacity(table_capacity),
+      chunks(new const HashableState *[table_capacity]) {}
+
+    const uint64_t version;
+    std::atomic<size_t> num_states;
+    const size_t capacity;
+    std::unique_ptr<const HashableState *[]> chunks;
+  };
+
+  PublishedStates() : table(nullptr) {}
+  ~PublishedStates() {
+    delete table.load();
+  }
+
+  EpochDomain epochs;
+  std::atomic<Table *> table;
+};
+}  // namespace internal
+
+// Read-only access to the states of a HashManager from other threads while
+// the hash manager's own thread keeps adding states to it, e.g. for
+// visualization or monitoring of a running search (see
+// HashManager::AddObserver()).
+//
+// Each View taken with Read() is a consistent snapshot of the states with IDs
+// 0..Size()-1 at the time it was taken. Reading never takes a lock, and the
+// hash manager never waits for observers: memory that a view may still
+// reference, such as the states dropped by HashManager::Reset(), is only
+// released once no view that could see it remains.
+//
+// An observer is used by one thread at a time, and must outlive its views.
+// Views should be short-lived: while any view is open, memory released by
+// the hash manager is held back.
+template <class HashableState>
+class StateObserver {
+ public:
+  class View;
+
+  StateObserver(StateObserver &&other) : published_(std::move(
+                                                        other.published_)), slot_(other.slot_), num_views_(0) {}
+  StateObserver &operator=(StateObserver &&other) {
+    StateObserver(std::move(other)).Swap(*this);
+    return *this;
+  }
+  ~StateObserver() {
+    if (published_) {
+      published_->epochs.UnregisterReader(slot_);
+    }
+  }
+
+  StateObserver(const StateObserver &) = delete;
+  StateObserver &operator=(const StateObserver &) = delete;
+
+  // Snapshot of the states published so far.
+  View Read();
+
+ private:
+  template <class> friend class StatePublisher;
+
+  explicit StateObserver(std::shared_ptr<internal::PublishedStates<HashableState>>
+                         published) : published_(std::move(published)),
+    slot_(published_->epochs.RegisterReader()), num_views_(0) {}
+
+  void Swap(StateObserver &other) {
+    std::swap(published_, other.published_);
+    std::swap(slot_, other.slot_);
+  }
+
+  std::shared_ptr<internal::PublishedStates<HashableState>> published_;
+  size_t slot_;
+  // Open views; the observer is in its reader epoch while there are any.
+  int num_views_;
+};
+
+template <class HashableState>
+class StateObserver<HashableState>::View {
+ public:
+  View(View &&other) : observer_(other.observer_), table_(other.table_),
+    num_states_(other.num_states_) {
+    other.observer_ = nullptr;
+  }
+  ~View() {
+    if (observer_ != nullptr && --observer_->num_views_ == 0) {
+      observer_->published_->epochs.Exit(observer_->slot_);
+    }
+  }
+
+  View(const View &) = delete;
+  View &operator=(const View &) = delete;
+
+  // The view holds the states with IDs 0..Size()-1.
+  size_t Size() const {
+    return num_states_;
+  }
+
+  // Number of times the hash manager was reset since observation started.
+  // States with the same ID in views of different versions are unrelated.
+  uint64_t Version() const {
+    return table_->version;
+  }
+
+  bool Exists(unsigned int state_id) const {
+    return state_id < num_states_;
+  }
+
+  // Throws error if the state ID is not in the view.
+  const HashableState &GetState(unsigned int state_id) const;
+
+  // Invokes fn(state_id, state) for every state in the view, in ID order.
+  template <typename Function>
+  void ForEach(Function fn) const;
+
+ private:
+  friend class StateObserver;
+
+  static constexpr unsigned int kChunkBits = StateStore<HashableState>::kChunkBits;
+  static constexpr unsigned int kChunkMask = StateStore<HashableState>::kChunkSize
+                                             - 1;
+
+  View(StateObserver *observer, const typename
+       internal::PublishedStates<HashableState>::Table *table) : observer_(observer),
+    table_(table), num_states_(table->num_states.load(std::memory_order_acquire)) {}
+
+  StateObserver *observer_;
+  const typename internal::PublishedStates<HashableState>::Table *table_;
+  size_t num_states_;
+};
+
+// Writer side of StateObserver: publishes the states of the StateStore it is
+// handed, from the thread that owns the store. Inactive (and free) until the
+// first observer is added. Copies do not publish.
+template <class HashableState>
+class StatePublisher {
+ public:
+  StatePublisher() = default;
+  StatePublisher(const StatePublisher &) {}
+  StatePublisher(StatePublisher &&other) = default;
+  StatePublisher &operator=(StatePublisher &&other) = default;
+
+  bool IsActive() const {
+    return published_ != nullptr;
+  }
+
+  // Starts publishing, if not yet active, and registers a new observer.
+  // Throws error if there are already EpochDomain::kMaxReaders observers.
+  template <class Allocator>
+  StateObserver<HashableState> AddObserver(const StateStore<HashableState, Allocator>
+                                           &states);
+
+  // Publishes the states added since the last call whose IDs extend the
+  // contiguous range of published IDs.
+  template <class Allocator>
+  void Publish(const StateStore<HashableState, Allocator> &states) {
+    if (published_) {
+      PublishPrefix(states);
+    }
+  }
+
+  // If active, takes over the states (leaving *states empty), publishes an
+  // empty table of the next version and retires the states until observers
+  // no longer read them. Returns false, and leaves *states alone, otherwise.
+  template <class Allocator>
+  bool RetireStates(StateStore<HashableState, Allocator> *states);
+
+  // Stops publishing, handing the states over to the observers, which keep
+  // reading the last published table until they are all destroyed.
+  template <class Allocator>
+  void Detach(StateStore<HashableState, Allocator> *states);
+
+ private:
+  typedef typename internal::PublishedStates<HashableState>::Table Table;
+
+  static constexpr unsigned int kChunkBits = StateStore<HashableState>::kChunkBits;
+  static constexpr unsigned int kChunkMask = StateStore<HashableState>::kChunkSize
+                                             - 1;
+  static constexpr size_t kInitialTableCapacity = 16;
+
+  template <class Allocator>
+  void PublishPrefix(const StateStore<HashableState, Allocator> &states);
+
+  // Replaces the published table with a copy of twice the capacity.
+  void GrowTable();
+
+  std::shared_ptr<internal::PublishedStates<HashableState>> published_;
+  // The published table, which only this writer modifies.
+  Table *table_ = nullptr;
+  size_t num_published_ = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Template Inline Implementation
+///////////////////////////////////////////////////////////////////////////////
+
+template <class HashableState>
+typename StateObserver<HashableState>::View StateObserver<HashableState>::Read() {
+  if (num_views_++ == 0) {
+    published_->epochs.Enter(slot_);
+  }
+
+  // Sequentially consistent, i.e. ordered after entering the epoch.
+  return View(this, published_->table.load());
+}
+
+template <class HashableState>
+const HashableState &StateObserver<HashableState>::View::GetState(
+  unsigned int state_id) const {
+  if (state_id >= num_states_) {
+    std::ostringstream ss;
+    ss << "Asked for state ID " << state_id << " not in observed view of " <<
+       num_states_ << " states" << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  return table_->chunks[state_id >> kChunkBits][state_id & kChunkMask];
+}
+
+template <class HashableState>
+template <typename Function>
+void StateObserver<HashableState>::View::ForEach(Function fn) const {
+  for (size_t begin = 0; begin < num_states_; begin += kChunkMask + 1) {
+    const HashableState *chunk = table_->chunks[begin >> kChunkBits];
+    const size_t end = std::min(num_states_, begin + kChunkMask + 1);
+
+    for (size_t state_id = begin; state_id < end; ++state_id) {
+      fn(static_cast<unsigned int>(state_id), chunk[state_id - begin]);
+    }
+  }
+}
+
+template <class HashableState>
+template <class Allocator>
+StateObserver<HashableState> StatePublisher<HashableState>::AddObserver(
+  const StateStore<HashableState, Allocator> &states) {
+  if (!published_) {
+    published_ = std::make_shared<internal::PublishedStates<HashableState>>();
+    table_ = new Table(0, kInitialTableCapacity);
+    num_published_ = 0;
+    published_->table.store(table_);
+    PublishPrefix(states);
+  }
+
+  return StateObserver<HashableState>(published_);
+}
+
+template <class HashableState>
+template <class Allocator>
+void StatePublisher<HashableState>::PublishPrefix(
+  const StateStore<HashableState, Allocator> &states) {
+  size_t num_states = num_published_;
+
+  for (; num_states < kInvalidStateID &&
+       states.IsInChunk(static_cast<unsigned int>(num_states)); ++num_states) {
+    if ((num_states & kChunkMask) != 0) {
+      continue;
+    }
+
+    const size_t chunk_index = num_states >> kChunkBits;
+
+    if (chunk_index == table_->capacity) {
+      GrowTable();
+    } else if (published_->epochs.NumPending() > 0) {
+      published_->epochs.Reclaim();
+    }
+
+    // Not yet visible to readers, who only look at chunks holding published
+    // states.
+    table_->chunks[chunk_index] = states.ChunkSlots(chunk_index);
+  }
+
+  if (num_states != num_published_) {
+    table_->num_states.store(num_states, std::memory_order_release);
+    num_published_ = num_states;
+  }
+}
+
+template <class HashableState>
+void StatePublisher<HashableState>::GrowTable() {
+  Table *old_table = table_;
+  table_ = new Table(old_table->version, 2 * old_table->capacity);
+  std::copy(old_table->chunks.get(), old_table->chunks.get() +
+            old_table->capacity, table_->chunks.get());
+  table_->num_states.store(num_published_, std::memory_order_relaxed);
+  published_->table.store(table_);
+  published_->epochs.Retire([old_table]() {
+    delete old_table;
+  });
+  published_->epochs.Reclaim();
+}
+
+template <class HashableState>
+template <class Allocator>
+bool StatePublisher<HashableState>::RetireStates(
+  StateStore<HashableState, Allocator> *states) {
+  if (!published_) {
+    return false;
+  }
+
+  // Unpublish the old table before retiring it, so that readers entering
+  // from now on cannot reach it.
+  Table *old_table = table_;
+  table_ = new Table(old_table->version + 1, kInitialTableCapacity);
+  num_published_ = 0;
+  published_->table.store(table_);
+
+  StateStore<HashableState, Allocator> *old_states = new
+  StateStore<HashableState, Allocator>(std::move(*states));
+  published_->epochs.Retire([old_table, old_states]() {
+    delete old_table;
+    delete old_states;
+  });
+  published_->epochs.Reclaim();
+  return true;
+}
+
+template <class HashableState>
+template <class Allocator>
+void StatePublisher<HashableState>::Detach(
+  StateStore<HashableState, Allocator> *states) {
+  if (!published_) {
+    return;
+  }
+
+  published_->epochs.Reclaim();
+  // The table stays published. Nothing reclaims after this, so the states
+  // are only deleted along with the observers' shared state.
+  StateStore<HashableState, Allocator> *old_states = new
+  StateStore<HashableState, Allocator>(std::move(*states));
+  published_->epochs.Retire([old_states]() {
+    delete old_states;
+  });
+  published_.reset();
+  table_ = nullptr;
+  num_published_ = 0;
+}
+}  // namespace sbpl_utils
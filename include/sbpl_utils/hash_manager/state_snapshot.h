@@ -0,0 +1,238 @@
+#pragma once
+
+#include <sbpl_utils/common/mapped_file.h>
+#include <sbpl_utils/hash_manager/state_store.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sbpl_utils {
+
+// Binary snapshot of the states and state IDs of a hash manager (see
+// HashManager::SaveSnapshot and HashManager::LoadSnapshot).
+//
+// The file holds a header followed by three arrays, sorted by state ID: the
+// state IDs, the states' hashes and the raw bytes of the states themselves.
+// Every array is aligned so that the file can be memory-mapped and the states
+// read in place, which is why snapshots are restricted to trivially copyable
+// states. Hashes are stored so that loading a snapshot never calls GetHash().
+// Consequently GetHash() must not depend on anything that differs between
+// processes, such as addresses. Snapshots use the writer's byte order.
+struct StateSnapshotHeader {
+  static constexpr uint32_t kVersion = 1;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t state_size;
+  uint32_t state_alignment;
+  uint32_t reserved;
+  uint64_t num_states;
+  uint64_t hashes_offset;
+  uint64_t states_offset;
+};
+
+namespace internal {
+constexpr char kStateSnapshotMagic[8] = {'S', 'B', 'P', 'L', 'S', 'N', 'A', 'P'};
+
+constexpr uint64_t AlignOffset(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+template <class HashableState>
+StateSnapshotHeader MakeStateSnapshotHeader(uint64_t num_states) {
+  StateSnapshotHeader header;
+  std::memcpy(header.magic, kStateSnapshotMagic, sizeof(header.magic));
+  header.version = StateSnapshotHeader::kVersion;
+  header.state_size = sizeof(HashableState);
+  header.state_alignment = alignof(HashableState);
+  header.reserved = 0;
+  header.num_states = num_states;
+  header.hashes_offset = AlignOffset(sizeof(StateSnapshotHeader) +
+                                     num_states * sizeof(uint32_t), sizeof(uint64_t));
+  header.states_offset = AlignOffset(header.hashes_offset + num_states * sizeof(
+                                       uint64_t), alignof(HashableState));
+  return header;
+}
+}  // namespace internal
+
+// Read-only, zero-copy view of a snapshot file. The file is memory-mapped, so
+// opening a snapshot only reads its header and state IDs, and states are only
+// paged in when accessed. Entries are indexed 0..Size()-1 in increasing order
+// of state ID.
+template <class HashableState>
+class StateSnapshot {
+  static_assert(std::is_trivially_copyable<HashableState>::value,
+                "Snapshots require trivially copyable states");
+
+ public:
+  // Throws error if the file cannot be mapped, was not written for
+  // HashableState, or is corrupt (truncated, or state IDs not strictly
+  // increasing).
+  explicit StateSnapshot(const std::string &path);
+
+  size_t Size() const {
+    return static_cast<size_t>(header_->num_states);
+  }
+
+  unsigned int StateID(size_t index) const {
+    return state_ids_[index];
+  }
+  size_t Hash(size_t index) const {
+    return static_cast<size_t>(hashes_[index]);
+  }
+  const HashableState &State(size_t index) const {
+    return states_[index];
+  }
+
+  // Returns nullptr if the snapshot does not contain the state ID.
+  const HashableState *Find(unsigned int state_id) const;
+
+ private:
+  MappedFile file_;
+  const StateSnapshotHeader *header_;
+  const uint32_t *state_ids_;
+  const uint64_t *hashes_;
+  const HashableState *states_;
+};
+
+// Writes the states of a StateStore to a snapshot file. Throws error on I/O
+// failure.
+template <class HashableState, class Allocator>
+void WriteStateSnapshot(const std::string &path,
+                        const StateStore<HashableState, Allocator> &states);
+
+///////////////////////////////////////////////////////////////////////////////
+// Template Inline Implementation
+///////////////////////////////////////////////////////////////////////////////
+
+template <class HashableState>
+StateSnapshot<HashableState>::StateSnapshot(const std::string &path) :
+  file_(path) {
+  std::ostringstream ss;
+  header_ = reinterpret_cast<const StateSnapshotHeader *>(file_.data());
+
+  if (file_.size() < sizeof(StateSnapshotHeader) ||
+      std::memcmp(header_->magic, internal::kStateSnapshotMagic,
+                  sizeof(header_->magic)) != 0) {
+    ss << "Not a state snapshot: " << path << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  // Bounds num_states before offsets are computed from it, so that they
+  // cannot overflow.
+  if (header_->num_states > file_.size() / sizeof(HashableState)) {
+    ss << "State snapshot " << path << " of " << file_.size() <<
+       " bytes is too small for " << header_->num_states << " states" << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  const StateSnapshotHeader expected =
+    internal::MakeStateSnapshotHeader<HashableState>(header_->num_states);
+
+  if (header_->version != expected.version ||
+      header_->state_size != expected.state_size ||
+      header_->state_alignment != expected.state_alignment ||
+      header_->hashes_offset != expected.hashes_offset ||
+      header_->states_offset != expected.states_offset ||
+      file_.size() < expected.states_offset + expected.num_states * sizeof(
+        HashableState)) {
+    ss << "State snapshot " << path << " (version " << header_->version <<
+       ", state size " << header_->state_size << ") does not match the state type"
+       << " (version " << expected.version << ", state size " <<
+       expected.state_size << ") or is truncated" << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  state_ids_ = reinterpret_cast<const uint32_t *>(file_.data() + sizeof(
+                                                    StateSnapshotHeader));
+  hashes_ = reinterpret_cast<const uint64_t *>(file_.data() +
+                                               header_->hashes_offset);
+  states_ = reinterpret_cast<const HashableState *>(file_.data() +
+                                                     header_->states_offset);
+
+  // Find() and HashManager::LoadSnapshot() rely on unique, sorted IDs.
+  for (size_t ii = 1; ii < Size(); ++ii) {
+    if (state_ids_[ii] <= state_ids_[ii - 1]) {
+      ss << "State snapshot " << path << " has state ID " << state_ids_[ii] <<
+         " after " << state_ids_[ii - 1] << std::endl;
+      throw std::runtime_error(ss.str());
+    }
+  }
+}
+
+template <class HashableState>
+const HashableState *StateSnapshot<HashableState>::Find(
+  unsigned int state_id) const {
+  // IDs are usually dense, in which case the entry index is the ID.
+  if (state_id < Size() && state_ids_[state_id] == state_id) {
+    return &states_[state_id];
+  }
+
+  const uint32_t *end = state_ids_ + Size();
+  const uint32_t *it = std::lower_bound(state_ids_, end, state_id);
+  return it == end || *it != state_id ? nullptr : &states_[it - state_ids_];
+}
+
+template <class HashableState, class Allocator>
+void WriteStateSnapshot(const std::string &path,
+                        const StateStore<HashableState, Allocator> &states) {
+  static_assert(std::is_trivially_copyable<HashableState>::value,
+                "Snapshots require trivially copyable states");
+
+  // ForEach visits sparse IDs in arbitrary order.
+  std::vector<std::pair<unsigned int, const HashableState *>> entries;
+  entries.reserve(states.Size());
+  states.ForEach([&](unsigned int state_id, const HashableState & state) {
+    entries.emplace_back(state_id, &state);
+  });
+  // IDs are unique, so this orders by ID.
+  std::sort(entries.begin(), entries.end());
+
+  const StateSnapshotHeader header =
+    internal::MakeStateSnapshotHeader<HashableState>(entries.size());
+  std::vector<uint32_t> state_ids;
+  std::vector<uint64_t> hashes;
+  state_ids.reserve(entries.size());
+  hashes.reserve(entries.size());
+
+  for (const auto &entry : entries) {
+    state_ids.push_back(entry.first);
+    hashes.push_back(entry.second->GetHash());
+  }
+
+  std::ofstream stream(path.c_str(), std::ios::binary | std::ios::trunc);
+  const char padding[alignof(HashableState) > sizeof(uint64_t) ?
+                     alignof(HashableState) : sizeof(uint64_t)] = {};
+  stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  stream.write(reinterpret_cast<const char *>(state_ids.data()),
+               state_ids.size() * sizeof(uint32_t));
+  stream.write(padding, header.hashes_offset - sizeof(header) -
+               state_ids.size() * sizeof(uint32_t));
+  stream.write(reinterpret_cast<const char *>(hashes.data()),
+               hashes.size() * sizeof(uint64_t));
+  stream.write(padding, header.states_offset - header.hashes_offset -
+               hashes.size() * sizeof(uint64_t));
+
+  for (const auto &entry : entries) {
+    stream.write(reinterpret_cast<const char *>(entry.second),
+                 sizeof(HashableState));
+  }
+
+  stream.close();
+
+  if (!stream) {
+    std::ostringstream ss;
+    ss << "Failed to write state snapshot " << path << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+}
+}  // namespace sbpl_utils
@@ -0,0 +1,617 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sbpl_utils {
+
+constexpr unsigned int kInvalidStateID =
+  std::numeric_limits<unsigned int>::max();
+
+// ID-addressed storage for the states owned by a HashManager.
+//
+// State IDs are handed out densely, so states live in fixed-size chunks that
+// are indexed directly by ID: a lookup is one shift, one mask and one array
+// access. Chunks are never moved or reallocated once created, so references
+// returned by Get() remain valid until the state is removed or the store is
+// cleared. IDs that are far beyond the dense range (e.g. inserted explicitly
+// through HashManager::InsertState) go to a sparse fallback map instead of
+// forcing allocation of all the chunks in between.
+//
+// Recycle() empties the store but keeps its chunks for reuse. Every chunk is
+// stamped with the generation of the store it was last written in, and
+// recycling bumps the store's generation, so stale chunks read as empty and
+// are wiped lazily when next written. For trivially destructible states this
+// makes emptying the store O(1).
+//
+// Chunks and sparse entries are obtained from Allocator (see HashManager).
+template <class HashableState,
+          class Allocator = std::allocator<HashableState>>
+class StateStore {
+ public:
+  class const_iterator;
+
+  // States with IDs in [i * kChunkSize, (i + 1) * kChunkSize) that are not in
+  // the sparse map are stored contiguously in chunk i.
+  static constexpr unsigned int kChunkBits = 10;
+  static constexpr unsigned int kChunkSize = 1u << kChunkBits;
+
+  explicit StateStore(const Allocator &allocator = Allocator());
+  StateStore(const StateStore &other);
+  StateStore(StateStore &&other);
+  StateStore &operator=(StateStore other);
+  ~StateStore();
+
+  void Swap(StateStore &other);
+
+  Allocator GetAllocator() const {
+    return Allocator(chunk_allocator_);
+  }
+
+  // Number of states in the store.
+  size_t Size() const {
+    return size_;
+  }
+
+  bool Exists(unsigned int state_id) const {
+    return Find(state_id) != nullptr;
+  }
+
+  // Returns nullptr if there is no state with the given ID.
+  const HashableState *Find(unsigned int state_id) const;
+  HashableState *Find(unsigned int state_id);
+
+  // Whether the state ID exists and is stored in a chunk rather than in the
+  // sparse map.
+  bool IsInChunk(unsigned int state_id) const {
+    const size_t chunk_index = state_id >> kChunkBits;
+    const Chunk *chunk = chunk_index < chunks_.size() ? LiveChunk(chunk_index) :
+                         nullptr;
+    return chunk != nullptr && chunk->IsOccupied(state_id & kChunkMask);
+  }
+
+  // First slot of chunk chunk_index, which must be allocated. Slots of a
+  // chunk stay at the same address until the store is cleared or destroyed,
+  // so readers that are handed the IDs of existing states can address them
+  // without going through the store (see StateObserver).
+  const HashableState *ChunkSlots(size_t chunk_index) const {
+    return chunks_[chunk_index]->Slot(0);
+  }
+
+  // Unchecked access: the state ID must exist.
+  const HashableState &Get(unsigned int state_id) const {
+    return *Find(state_id);
+  }
+
+  // Constructs a new state with the given ID in place. The ID must not
+  // already be in use.
+  template <typename... Args>
+  HashableState &Emplace(unsigned int state_id, Args &&... args);
+
+  // Destroys the state with the given ID, which must exist.
+  void Erase(unsigned int state_id);
+
+  // Returns the smallest ID at or above the allocation cursor that is not in
+  // use, i.e. the ID a forceful insertion should take. When all IDs were
+  // handed out densely, this is simply Size(). The cursor skips over IDs that
+  // were taken explicitly, so this is amortized O(1).
+  unsigned int NextFreeID() const;
+
+  // Destroys all states and releases all memory.
+  void Clear();
+
+  // Destroys all states but keeps the allocated chunks for reuse.
+  void Recycle();
+
+  // Approximate heap memory held by the store, in bytes.
+  size_t MemoryBytes() const;
+
+  // Invokes fn(state_id, state) for every stored state, dense IDs first in
+  // increasing order.
+  template <typename Function>
+  void ForEach(Function fn) const;
+
+  // Iteration yields (state, state ID) pairs in the same order as ForEach.
+  const_iterator begin() const;
+  const_iterator end() const;
+  // Iterator to the state with the given ID, which must exist.
+  const_iterator IteratorTo(unsigned int state_id) const;
+
+ private:
+  static constexpr unsigned int kChunkMask = kChunkSize - 1;
+  static constexpr unsigned int kWordsPerChunk = kChunkSize / 64;
+  // IDs are only kept dense if they need at most this many more chunks than
+  // are currently allocated; everything else goes to the sparse map.
+  static constexpr size_t kMaxDenseChunkGap = 64;
+
+  struct Chunk {
+    typename std::aligned_storage<sizeof(HashableState),
+             alignof(HashableState)>::type slots[kChunkSize];
+    uint64_t occupied[kWordsPerChunk] = {};
+    // Generation of the store in which occupied was last valid.
+    uint64_t generation = 0;
+
+    bool IsOccupied(unsigned int offset) const {
+      return (occupied[offset >> 6] >> (offset & 63)) & 1;
+    }
+    HashableState *Slot(unsigned int offset) {
+      return reinterpret_cast<HashableState *>(&slots[offset]);
+    }
+    const HashableState *Slot(unsigned int offset) const {
+      return reinterpret_cast<const HashableState *>(&slots[offset]);
+    }
+  };
+
+  typedef std::allocator_traits<Allocator> AllocatorTraits;
+  typedef typename AllocatorTraits::template rebind_alloc<Chunk> ChunkAllocator;
+  typedef typename AllocatorTraits::template rebind_alloc<Chunk *>
+  ChunkPointerAllocator;
+  typedef std::vector<Chunk *, ChunkPointerAllocator> ChunkVector;
+
+  // Returns nullptr if the chunk is not allocated or stale.
+  const Chunk *LiveChunk(size_t chunk_index) const {
+    const Chunk *chunk = chunks_[chunk_index];
+    return chunk != nullptr && chunk->generation == generation_ ? chunk : nullptr;
+  }
+  Chunk *LiveChunk(size_t chunk_index) {
+    return const_cast<Chunk *>(static_cast<const StateStore *>(this)->LiveChunk(
+                                 chunk_index));
+  }
+
+  // Runs the destructors of all stored states without releasing memory.
+  void DestroyStates();
+
+  Chunk *NewChunk();
+  void DeleteChunk(Chunk *chunk);
+
+  bool IsDenseID(unsigned int state_id) const {
+    return (state_id >> kChunkBits) < chunks_.size() + kMaxDenseChunkGap;
+  }
+
+  typedef std::unordered_map<unsigned int, HashableState, std::hash<unsigned int>,
+          std::equal_to<unsigned int>, typename AllocatorTraits::template rebind_alloc<std::pair<const unsigned int, HashableState>>>
+          SparseStates;
+
+  ChunkAllocator chunk_allocator_;
+  ChunkVector chunks_;
+  SparseStates sparse_states_;
+  size_t size_ = 0;
+  unsigned int next_free_id_ = 0;
+  uint64_t generation_ = 0;
+};
+
+template <class HashableState, class Allocator>
+class StateStore<HashableState, Allocator>::const_iterator {
+ public:
+  typedef std::pair<const HashableState &, unsigned int> value_type;
+  typedef std::forward_iterator_tag iterator_category;
+  typedef std::ptrdiff_t difference_type;
+  typedef const value_type *pointer;
+  typedef value_type reference;
+
+  // Entries are materialized on the fly, so operator-> hands out a proxy.
+  struct ArrowProxy {
+    value_type entry;
+    const value_type *operator->() const {
+      return &entry;
+    }
+  };
+
+  value_type operator*() const {
+    return in_sparse_ ? value_type(sparse_it_->second, sparse_it_->first) :
+           value_type(*store_->chunks_[chunk_index_]->Slot(offset_),
+                      static_cast<unsigned int>((chunk_index_ << kChunkBits) | offset_));
+  }
+  ArrowProxy operator->() const {
+    return ArrowProxy{**this};
+  }
+  const_iterator &operator++() {
+    if (in_sparse_) {
+      ++sparse_it_;
+    } else {
+      ++offset_;
+      SkipToOccupied();
+    }
+
+    return *this;
+  }
+  const_iterator operator++(int) {
+    const_iterator it = *this;
+    ++*this;
+    return it;
+  }
+  bool operator==(const const_iterator &other) const {
+    return in_sparse_ == other.in_sparse_ && (in_sparse_ ?
+                                              sparse_it_ == other.sparse_it_ :
+                                              chunk_index_ == other.chunk_index_ && offset_ == other.offset_);
+  }
+  bool operator!=(const const_iterator &other) const {
+    return !(*this == other);
+  }
+
+ private:
+  friend class StateStore;
+
+  const_iterator(const StateStore *store, bool at_end) : store_(store),
+    chunk_index_(0), offset_(0), in_sparse_(at_end),
+    sparse_it_(at_end ? store->sparse_states_.end() :
+               store->sparse_states_.begin()) {
+    if (!at_end) {
+      SkipToOccupied();
+    }
+  }
+
+  // Advances to the first occupied dense slot at or after the current
+  // position, falling through to the sparse states once the chunks run out.
+  void SkipToOccupied() {
+    for (; chunk_index_ < store_->chunks_.size(); ++chunk_index_, offset_ = 0) {
+      const Chunk *chunk = store_->LiveChunk(chunk_index_);
+
+      if (!chunk) {
+        continue;
+      }
+
+      for (; offset_ < kChunkSize; ++offset_) {
+        if (chunk->IsOccupied(offset_)) {
+          return;
+        }
+      }
+    }
+
+    in_sparse_ = true;
+  }
+
+  const StateStore *store_;
+  size_t chunk_index_;
+  unsigned int offset_;
+  bool in_sparse_;
+  typename SparseStates::const_iterator sparse_it_;
+};
+
+// Read-only view over the (state, state ID) pairs held by a HashManager.
+// Besides iteration, it supports the lookups of the std::unordered_map from
+// states to IDs that GetStateMappings() used to return: find(), count() and
+// at(). Other map members (e.g. bucket interface, operator[]) are gone.
+template <class HashableState,
+          class Allocator = std::allocator<HashableState>>
+class StateMappings {
+ public:
+  typedef typename StateStore<HashableState, Allocator>::const_iterator const_iterator;
+  // Returns the ID of the stored state equal to the given one, or
+  // kInvalidStateID.
+  typedef std::function<unsigned int(const HashableState &)> StateIDFinder;
+
+  StateMappings(const StateStore<HashableState, Allocator> &store,
+                StateIDFinder find_state_id) : store_(&store),
+    find_state_id_(std::move(find_state_id)) {}
+
+  const_iterator begin() const {
+    return store_->begin();
+  }
+  const_iterator end() const {
+    return store_->end();
+  }
+  size_t size() const {
+    return store_->Size();
+  }
+  bool empty() const {
+    return store_->Size() == 0;
+  }
+
+  // Entry of the stored state equal to hashable_state, or end().
+  const_iterator find(const HashableState &hashable_state) const {
+    const unsigned int state_id = find_state_id_(hashable_state);
+    return state_id == kInvalidStateID ? end() : store_->IteratorTo(state_id);
+  }
+  size_t count(const HashableState &hashable_state) const {
+    return find_state_id_(hashable_state) == kInvalidStateID ? 0 : 1;
+  }
+  // Throws std::out_of_range if the state does not exist, as
+  // std::unordered_map::at does.
+  unsigned int at(const HashableState &hashable_state) const {
+    const unsigned int state_id = find_state_id_(hashable_state);
+
+    if (state_id == kInvalidStateID) {
+      throw std::out_of_range("StateMappings::at: state does not exist");
+    }
+
+    return state_id;
+  }
+
+ private:
+  const StateStore<HashableState, Allocator> *store_;
+  StateIDFinder find_state_id_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Template Inline Implementation
+///////////////////////////////////////////////////////////////////////////////
+
+template <class HashableState, class Allocator>
+StateStore<HashableState, Allocator>::StateStore(const Allocator &allocator) :
+  chunk_allocator_(allocator), chunks_(ChunkPointerAllocator(allocator)),
+  sparse_states_(0, std::hash<unsigned int>(), std::equal_to<unsigned int>(),
+                 typename SparseStates::allocator_type(allocator)) {}
+
+template <class HashableState, class Allocator>
+StateStore<HashableState, Allocator>::StateStore(const StateStore &other) :
+  StateStore(Allocator(other.chunk_allocator_)) {
+  other.ForEach([this](unsigned int state_id, const HashableState & state) {
+    Emplace(state_id, state);
+  });
+  next_free_id_ = other.next_free_id_;
+}
+
+template <class HashableState, class Allocator>
+StateStore<HashableState, Allocator>::StateStore(StateStore &&other) :
+  StateStore(Allocator(other.chunk_allocator_)) {
+  Swap(other);
+}
+
+template <class HashableState, class Allocator>
+StateStore<HashableState, Allocator> &StateStore<HashableState, Allocator>::operator=(
+  StateStore other) {
+  Swap(other);
+  return *this;
+}
+
+template <class HashableState, class Allocator>
+StateStore<HashableState, Allocator>::~StateStore() {
+  Clear();
+}
+
+template <class HashableState, class Allocator>
+void StateStore<HashableState, Allocator>::Swap(StateStore &other) {
+  std::swap(chunk_allocator_, other.chunk_allocator_);
+  chunks_.swap(other.chunks_);
+  sparse_states_.swap(other.sparse_states_);
+  std::swap(size_, other.size_);
+  std::swap(next_free_id_, other.next_free_id_);
+  std::swap(generation_, other.generation_);
+}
+
+template <class HashableState, class Allocator>
+const HashableState *StateStore<HashableState, Allocator>::Find(
+  unsigned int state_id) const {
+  const size_t chunk_index = state_id >> kChunkBits;
+  const Chunk *chunk = chunk_index < chunks_.size() ? LiveChunk(chunk_index) :
+                       nullptr;
+
+  if (chunk != nullptr) {
+    const unsigned int offset = state_id & kChunkMask;
+
+    if (chunk->IsOccupied(offset)) {
+      return chunk->Slot(offset);
+    }
+  }
+
+  if (sparse_states_.empty()) {
+    return nullptr;
+  }
+
+  const auto it = sparse_states_.find(state_id);
+  return it == sparse_states_.end() ? nullptr : &it->second;
+}
+
+template <class HashableState, class Allocator>
+HashableState *StateStore<HashableState, Allocator>::Find(unsigned int state_id) {
+  return const_cast<HashableState *>(
+           static_cast<const StateStore *>(this)->Find(state_id));
+}
+
+template <class HashableState, class Allocator>
+template <typename... Args>
+HashableState &StateStore<HashableState, Allocator>::Emplace(unsigned int state_id,
+                                                  Args &&... args) {
+  HashableState *state = nullptr;
+
+  if (IsDenseID(state_id)) {
+    const size_t chunk_index = state_id >> kChunkBits;
+
+    if (chunk_index >= chunks_.size()) {
+      chunks_.resize(chunk_index + 1);
+    }
+
+    if (!chunks_[chunk_index]) {
+      chunks_[chunk_index] = NewChunk();
+    }
+
+    Chunk &chunk = *chunks_[chunk_index];
+
+    if (chunk.generation != generation_) {
+      std::fill(chunk.occupied, chunk.occupied + kWordsPerChunk, 0);
+      chunk.generation = generation_;
+    }
+
+    const unsigned int offset = state_id & kChunkMask;
+    state = new (chunk.Slot(offset)) HashableState(std::forward<Args>(args)...);
+    chunk.occupied[offset >> 6] |= uint64_t(1) << (offset & 63);
+  } else {
+    state = &sparse_states_.emplace(std::piecewise_construct,
+                                    std::forward_as_tuple(state_id),
+                                    std::forward_as_tuple(std::forward<Args>(args)...)).first->second;
+  }
+
+  ++size_;
+
+  while (Exists(next_free_id_)) {
+    ++next_free_id_;
+  }
+
+  return *state;
+}
+
+template <class HashableState, class Allocator>
+void StateStore<HashableState, Allocator>::Erase(unsigned int state_id) {
+  const size_t chunk_index = state_id >> kChunkBits;
+  Chunk *chunk = chunk_index < chunks_.size() ? LiveChunk(chunk_index) :
+                 nullptr;
+  const unsigned int offset = state_id & kChunkMask;
+
+  if (chunk != nullptr && chunk->IsOccupied(offset)) {
+    chunk->Slot(offset)->~HashableState();
+    chunk->occupied[offset >> 6] &= ~(uint64_t(1) << (offset & 63));
+  } else {
+    sparse_states_.erase(state_id);
+  }
+
+  --size_;
+
+  if (state_id < next_free_id_) {
+    next_free_id_ = state_id;
+  }
+}
+
+template <class HashableState, class Allocator>
+unsigned int StateStore<HashableState, Allocator>::NextFreeID() const {
+  return next_free_id_;
+}
+
+template <class HashableState, class Allocator>
+typename StateStore<HashableState, Allocator>::const_iterator
+StateStore<HashableState, Allocator>::begin() const {
+  return const_iterator(this, false);
+}
+
+template <class HashableState, class Allocator>
+typename StateStore<HashableState, Allocator>::const_iterator
+StateStore<HashableState, Allocator>::end() const {
+  return const_iterator(this, true);
+}
+
+template <class HashableState, class Allocator>
+typename StateStore<HashableState, Allocator>::const_iterator
+StateStore<HashableState, Allocator>::IteratorTo(unsigned int state_id) const {
+  if (!IsInChunk(state_id)) {
+    const_iterator it(this, true);
+    it.sparse_it_ = sparse_states_.find(state_id);
+    return it;
+  }
+
+  // Dense iterators continue into the sparse states, so start them there.
+  const_iterator it(this, false);
+  it.in_sparse_ = false;
+  it.chunk_index_ = state_id >> kChunkBits;
+  it.offset_ = state_id & kChunkMask;
+  it.sparse_it_ = sparse_states_.begin();
+  return it;
+}
+
+template <class HashableState, class Allocator>
+void StateStore<HashableState, Allocator>::DestroyStates() {
+  if (std::is_trivially_destructible<HashableState>::value) {
+    return;
+  }
+
+  for (size_t chunk_index = 0; chunk_index < chunks_.size(); ++chunk_index) {
+    Chunk *chunk = LiveChunk(chunk_index);
+
+    if (!chunk) {
+      continue;
+    }
+
+    for (unsigned int offset = 0; offset < kChunkSize; ++offset) {
+      if (chunk->IsOccupied(offset)) {
+        chunk->Slot(offset)->~HashableState();
+      }
+    }
+  }
+}
+
+template <class HashableState, class Allocator>
+void StateStore<HashableState, Allocator>::Clear() {
+  DestroyStates();
+
+  for (Chunk *chunk : chunks_) {
+    if (chunk) {
+      DeleteChunk(chunk);
+    }
+  }
+
+  // Swap with empty containers to release their memory, too.
+  ChunkVector(chunks_.get_allocator()).swap(chunks_);
+  SparseStates(0, sparse_states_.hash_function(), sparse_states_.key_eq(),
+               sparse_states_.get_allocator()).swap(sparse_states_);
+  size_ = 0;
+  next_free_id_ = 0;
+}
+
+template <class HashableState, class Allocator>
+typename StateStore<HashableState, Allocator>::Chunk *
+StateStore<HashableState, Allocator>::NewChunk() {
+  Chunk *chunk = std::allocator_traits<ChunkAllocator>::allocate(chunk_allocator_,
+                                                                 1);
+  new (chunk) Chunk();
+  chunk->generation = generation_;
+  return chunk;
+}
+
+template <class HashableState, class Allocator>
+void StateStore<HashableState, Allocator>::DeleteChunk(Chunk *chunk) {
+  chunk->~Chunk();
+  std::allocator_traits<ChunkAllocator>::deallocate(chunk_allocator_, chunk, 1);
+}
+
+template <class HashableState, class Allocator>
+void StateStore<HashableState, Allocator>::Recycle() {
+  DestroyStates();
+  // Invalidates every chunk at once.
+  ++generation_;
+  sparse_states_.clear();
+  size_ = 0;
+  next_free_id_ = 0;
+}
+
+template <class HashableState, class Allocator>
+size_t StateStore<HashableState, Allocator>::MemoryBytes() const {
+  size_t bytes = chunks_.capacity() * sizeof(chunks_[0]);
+
+  for (const auto &chunk : chunks_) {
+    bytes += chunk ? sizeof(Chunk) : 0;
+  }
+
+  // Each sparse state is a node holding the entry and a next pointer, plus a
+  // cached hash.
+  return bytes + sparse_states_.bucket_count() * sizeof(void *) +
+         sparse_states_.size() * (sizeof(typename SparseStates::value_type) + 2 *
+                                  sizeof(void *));
+}
+
+template <class HashableState, class Allocator>
+template <typename Function>
+void StateStore<HashableState, Allocator>::ForEach(Function fn) const {
+  for (size_t chunk_index = 0; chunk_index < chunks_.size(); ++chunk_index) {
+    const Chunk *chunk = LiveChunk(chunk_index);
+
+    if (!chunk) {
+      continue;
+    }
+
+    for (unsigned int word = 0; word < kWordsPerChunk; ++word) {
+      uint64_t bits = chunk->occupied[word];
+
+      while (bits) {
+        const unsigned int offset = word * 64 + __builtin_ctzll(bits);
+        bits &= bits - 1;
+        fn(static_cast<unsigned int>((chunk_index << kChunkBits) | offset),
+           *chunk->Slot(offset));
+      }
+    }
+  }
+
+  for (const auto &entry : sparse_states_) {
+    fn(entry.first, entry.second);
+  }
+}
+}  // namespace sbpl_utils
@@ -0,0 +1,64 @@
+#include <sbpl_utils/common/arena.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace sbpl_utils {
+
+namespace {
+// Blocks stop doubling in size at this point.
+constexpr size_t kMaxBlockSize = size_t(64) << 20;
+}  // namespace
+
+MonotonicArena::MonotonicArena(size_t initial_block_size) :
+  initial_block_size_(std::max(initial_block_size, sizeof(Block) * 2)),
+  next_block_size_(initial_block_size_) {}
+
+MonotonicArena::~MonotonicArena() {
+  Release();
+}
+
+void *MonotonicArena::Allocate(size_t num_bytes, size_t alignment) {
+  uintptr_t address = (reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) &
+                      ~(uintptr_t(alignment) - 1);
+
+  if (cursor_ == nullptr || address + num_bytes > reinterpret_cast<uintptr_t>
+      (end_)) {
+    AddBlock(num_bytes, alignment);
+    address = (reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) &
+              ~(uintptr_t(alignment) - 1);
+  }
+
+  cursor_ = reinterpret_cast<char *>(address + num_bytes);
+  bytes_allocated_ += num_bytes;
+  return reinterpret_cast<void *>(address);
+}
+
+void MonotonicArena::AddBlock(size_t num_bytes, size_t alignment) {
+  const size_t block_size = std::max(next_block_size_,
+                                     sizeof(Block) + num_bytes + alignment);
+  Block *block = static_cast<Block *>(::operator new(block_size));
+  block->previous = current_block_;
+  block->size = block_size;
+  current_block_ = block;
+  cursor_ = reinterpret_cast<char *>(block + 1);
+  end_ = reinterpret_cast<char *>(block) + block_size;
+  bytes_reserved_ += block_size;
+  next_block_size_ = std::min(kMaxBlockSize, next_block_size_ * 2);
+}
+
+void MonotonicArena::Release() {
+  while (current_block_ != nullptr) {
+    Block *previous = current_block_->previous;
+    ::operator delete(current_block_);
+    current_block_ = previous;
+  }
+
+  next_block_size_ = initial_block_size_;
+  cursor_ = nullptr;
+  end_ = nullptr;
+  bytes_allocated_ = 0;
+  bytes_reserved_ = 0;
+}
+}  // namespace sbpl_utils
@@ -0,0 +1,85 @@
+#include <sbpl_utils/common/epoch.h>
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace sbpl_utils {
+
+constexpr size_t EpochDomain::kMaxReaders;
+constexpr uint64_t EpochDomain::kInactive;
+
+EpochDomain::EpochDomain() : global_epoch_(kInactive + 1) {
+  for (auto &slot : slots_) {
+    slot.epoch.store(kInactive, std::memory_order_relaxed);
+    slot.in_use.store(false, std::memory_order_relaxed);
+  }
+}
+
+EpochDomain::~EpochDomain() {
+  for (auto &entry : retired_) {
+    entry.second();
+  }
+}
+
+size_t EpochDomain::RegisterReader() {
+  for (size_t slot = 0; slot < kMaxReaders; ++slot) {
+    bool in_use = false;
+
+    if (slots_[slot].in_use.compare_exchange_strong(in_use, true)) {
+      return slot;
+    }
+  }
+
+  std::ostringstream ss;
+  ss << "All " << kMaxReaders << " reader slots are in use" << std::endl;
+  throw std::runtime_error(ss.str());
+}
+
+void EpochDomain::UnregisterReader(size_t slot) {
+  slots_[slot].epoch.store(kInactive);
+  slots_[slot].in_use.store(false);
+}
+
+void EpochDomain::Enter(size_t slot) {
+  // Sequentially consistent, so that the epoch is visible to Reclaim() before
+  // the reader loads any pointer.
+  slots_[slot].epoch.store(global_epoch_.load());
+}
+
+void EpochDomain::Exit(size_t slot) {
+  slots_[slot].epoch.store(kInactive);
+}
+
+void EpochDomain::Retire(std::function<void()> deleter) {
+  // Readers that could still see the object entered in this epoch or earlier.
+  retired_.emplace_back(global_epoch_.fetch_add(1), std::move(deleter));
+}
+
+size_t EpochDomain::Reclaim() {
+  if (retired_.empty()) {
+    return 0;
+  }
+
+  uint64_t oldest_epoch = std::numeric_limits<uint64_t>::max();
+
+  for (const auto &slot : slots_) {
+    const uint64_t epoch = slot.epoch.load();
+
+    if (epoch != kInactive) {
+      oldest_epoch = std::min(oldest_epoch, epoch);
+    }
+  }
+
+  size_t num_reclaimed = 0;
+
+  for (; num_reclaimed < retired_.size() &&
+       retired_[num_reclaimed].first < oldest_epoch; ++num_reclaimed) {
+    retired_[num_reclaimed].second();
+  }
+
+  retired_.erase(retired_.begin(), retired_.begin() + num_reclaimed);
+  return retired_.size();
+}
+}  // namespace sbpl_utils
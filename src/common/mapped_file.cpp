@@ -0,0 +1,86 @@
+#include <sbpl_utils/common/mapped_file.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace sbpl_utils {
+
+namespace {
+void ThrowError(const std::string &what, const std::string &path) {
+  std::ostringstream ss;
+  ss << "Failed to " << what << " " << path << ": " << std::strerror(errno) <<
+     std::endl;
+  throw std::runtime_error(ss.str());
+}
+}  // namespace
+
+MappedFile::MappedFile(const std::string &path) : path_(path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    ThrowError("open", path);
+  }
+
+  struct stat file_stat;
+
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    ThrowError("stat", path);
+  }
+
+  size_ = static_cast<size_t>(file_stat.st_size);
+
+  if (size_ > 0) {
+    void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (data == MAP_FAILED) {
+      close(fd);
+      ThrowError("map", path);
+    }
+
+    data_ = static_cast<const char *>(data);
+  }
+
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  Unmap();
+}
+
+MappedFile::MappedFile(MappedFile &&other) : path_(std::move(other.path_)),
+  data_(other.data_), size_(other.size_) {
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) {
+  if (this != &other) {
+    Unmap();
+    path_ = std::move(other.path_);
+    data_ = other.data_;
+    size_ = other.size_;
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+
+  return *this;
+}
+
+void MappedFile::Unmap() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char *>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
+}  // namespace sbpl_utils
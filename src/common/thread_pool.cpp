@@ -0,0 +1,101 @@
+#include <sbpl_utils/common/thread_pool.h>
+
+namespace sbpl_utils {
+
+ThreadPool::ThreadPool(size_t num_threads) : next_task_(0) {
+  for (size_t ii = 1; ii < num_threads; ++ii) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+
+  job_ready_.notify_all();
+
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::ParallelFor(size_t num_tasks,
+                             const std::function<void(size_t)> &fn) {
+  if (workers_.empty() || num_tasks <= 1) {
+    for (size_t task = 0; task < num_tasks; ++task) {
+      fn(task);
+    }
+
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = &fn;
+    num_tasks_ = num_tasks;
+    next_task_.store(0);
+    num_busy_workers_ = workers_.size();
+    exception_ = nullptr;
+    ++job_generation_;
+  }
+
+  job_ready_.notify_all();
+  RunTasks();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_done_.wait(lock, [this]() {
+    return num_busy_workers_ == 0;
+  });
+  job_ = nullptr;
+
+  if (exception_) {
+    std::rethrow_exception(exception_);
+  }
+}
+
+void ThreadPool::WorkerLoop() {
+  uint64_t last_generation = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_ready_.wait(lock, [&]() {
+        return stopping_ || job_generation_ != last_generation;
+      });
+
+      if (stopping_) {
+        return;
+      }
+
+      last_generation = job_generation_;
+    }
+
+    RunTasks();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (--num_busy_workers_ == 0) {
+        job_done_.notify_one();
+      }
+    }
+  }
+}
+
+void ThreadPool::RunTasks() {
+  for (size_t task = next_task_.fetch_add(1); task < num_tasks_;
+       task = next_task_.fetch_add(1)) {
+    try {
+      (*job_)(task);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (!exception_) {
+        exception_ = std::current_exception();
+      }
+    }
+  }
+}
+}  // namespace sbpl_utils
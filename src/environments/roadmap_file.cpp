@@ -0,0 +1,371 @@
+#include <sbpl_utils/environments/roadmap_file.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace sbpl_utils {
+
+constexpr uint32_t RoadmapHeader::kVersion;
+
+namespace {
+constexpr char kRoadmapMagic[8] = {'S', 'B', 'P', 'L', 'R', 'M', 'A', 'P'};
+
+constexpr uint64_t AlignOffset(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+RoadmapHeader MakeRoadmapHeader(uint64_t num_vertices, uint64_t num_edges) {
+  RoadmapHeader header;
+  std::memcpy(header.magic, kRoadmapMagic, sizeof(header.magic));
+  header.version = RoadmapHeader::kVersion;
+  header.reserved = 0;
+  header.num_vertices = num_vertices;
+  header.num_edges = num_edges;
+  header.heuristics_offset = sizeof(RoadmapHeader);
+  header.offsets_offset = AlignOffset(header.heuristics_offset + num_vertices *
+                                      sizeof(int32_t), sizeof(uint64_t));
+  header.targets_offset = header.offsets_offset + (num_vertices + 1) * sizeof(
+                            uint64_t);
+  header.costs_offset = header.targets_offset + num_edges * sizeof(int32_t);
+  header.probabilities_offset = AlignOffset(header.costs_offset + num_edges *
+                                            sizeof(int32_t), sizeof(double));
+  header.evaluation_times_offset = header.probabilities_offset + num_edges *
+                                   sizeof(double);
+  return header;
+}
+
+// Writes the arrays of a roadmap with the given header.
+void WriteRoadmapArrays(const std::string &path, const RoadmapHeader &header,
+                        const int32_t *heuristics, const uint64_t *offsets, const int32_t *targets,
+                        const int32_t *costs, const double *probabilities,
+                        const double *evaluation_times) {
+  std::ofstream stream(path.c_str(), std::ios::binary | std::ios::trunc);
+  const char padding[sizeof(uint64_t)] = {};
+  stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  stream.write(reinterpret_cast<const char *>(heuristics),
+               header.num_vertices * sizeof(int32_t));
+  stream.write(padding, header.offsets_offset - header.heuristics_offset -
+               header.num_vertices * sizeof(int32_t));
+  stream.write(reinterpret_cast<const char *>(offsets),
+               (header.num_vertices + 1) * sizeof(uint64_t));
+  stream.write(reinterpret_cast<const char *>(targets),
+               header.num_edges * sizeof(int32_t));
+  stream.write(reinterpret_cast<const char *>(costs),
+               header.num_edges * sizeof(int32_t));
+  stream.write(padding, header.probabilities_offset - header.costs_offset -
+               header.num_edges * sizeof(int32_t));
+  stream.write(reinterpret_cast<const char *>(probabilities),
+               header.num_edges * sizeof(double));
+  stream.write(reinterpret_cast<const char *>(evaluation_times),
+               header.num_edges * sizeof(double));
+  stream.close();
+
+  if (!stream) {
+    std::ostringstream ss;
+    ss << "Failed to write roadmap " << path << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+}
+
+// One parsed line of an edge list.
+struct EdgeListLine {
+  enum Type { kNone, kVertex, kEdge } type = kNone;
+  long from = 0;
+  long to = 0;
+  long value = 0;
+  double probability = 1.0;
+  double evaluation_time = 0.0;
+};
+
+// Parses the number at *cursor and advances past it, or returns false if there
+// is none.
+bool ParseField(const char **cursor, long *value) {
+  char *end = nullptr;
+  *value = std::strtol(*cursor, &end, 10);
+  const bool parsed = end != *cursor;
+  *cursor = end;
+  return parsed;
+}
+bool ParseField(const char **cursor, double *value) {
+  char *end = nullptr;
+  *value = std::strtod(*cursor, &end);
+  const bool parsed = end != *cursor;
+  *cursor = end;
+  return parsed;
+}
+
+// Parses a "v" or "e" line, or leaves the type as kNone for blank lines and
+// comments.
+EdgeListLine ParseEdgeListLine(const std::string &line,
+                               const std::string &path, size_t line_number) {
+  EdgeListLine parsed;
+  const char *cursor = line.c_str();
+
+  while (*cursor == ' ' || *cursor == '\t') {
+    ++cursor;
+  }
+
+  if (*cursor == '\0' || *cursor == '\r' || *cursor == '#') {
+    return parsed;
+  }
+
+  bool valid = false;
+
+  if (*cursor == 'v') {
+    ++cursor;
+    parsed.type = EdgeListLine::kVertex;
+    valid = ParseField(&cursor, &parsed.from) &&
+            ParseField(&cursor, &parsed.value);
+  } else if (*cursor == 'e') {
+    ++cursor;
+    parsed.type = EdgeListLine::kEdge;
+    valid = ParseField(&cursor, &parsed.from) && ParseField(&cursor, &parsed.to) &&
+            ParseField(&cursor, &parsed.value);
+
+    if (valid && !ParseField(&cursor, &parsed.probability)) {
+      parsed.probability = 1.0;
+    } else if (valid && !ParseField(&cursor, &parsed.evaluation_time)) {
+      parsed.evaluation_time = 0.0;
+    }
+  }
+
+  if (!valid) {
+    std::ostringstream ss;
+    ss << "Malformed line " << line_number << " in edge list " << path <<
+       std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  // IDs index int32 arrays of size max ID + 1, and negative costs are
+  // reserved for removed edges.
+  const long kMaxValue = std::numeric_limits<int32_t>::max();
+  const long kMinValue = parsed.type == EdgeListLine::kEdge ? 0 :
+                         std::numeric_limits<int32_t>::min();
+
+  if (parsed.from < 0 || parsed.from >= kMaxValue || parsed.to < 0 ||
+      parsed.to >= kMaxValue || parsed.value < kMinValue ||
+      parsed.value > kMaxValue) {
+    std::ostringstream ss;
+    ss << "Vertex ID, cost or heuristic out of range on line " << line_number <<
+       " in edge list " << path << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  return parsed;
+}
+}  // namespace
+
+RoadmapFile::RoadmapFile(const std::string &path) : file_(path) {
+  std::ostringstream ss;
+  header_ = reinterpret_cast<const RoadmapHeader *>(file_.data());
+
+  if (file_.size() < sizeof(RoadmapHeader) ||
+      std::memcmp(header_->magic, kRoadmapMagic, sizeof(header_->magic)) != 0) {
+    ss << "Not a roadmap: " << path << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  // Bounds the counts by the bytes each vertex and edge takes before offsets
+  // are computed from them, so that they cannot overflow.
+  const uint64_t vertex_bytes = sizeof(int32_t) + sizeof(uint64_t);
+  const uint64_t edge_bytes = 2 * sizeof(int32_t) + 2 * sizeof(double);
+
+  if (header_->num_vertices > file_.size() / vertex_bytes ||
+      header_->num_edges > file_.size() / edge_bytes) {
+    ss << "Roadmap " << path << " of " << file_.size() <<
+       " bytes is too small for " << header_->num_vertices << " vertices and " <<
+       header_->num_edges << " edges" << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  const RoadmapHeader expected = MakeRoadmapHeader(header_->num_vertices,
+                                                   header_->num_edges);
+
+  if (header_->version != expected.version ||
+      header_->heuristics_offset != expected.heuristics_offset ||
+      header_->offsets_offset != expected.offsets_offset ||
+      header_->targets_offset != expected.targets_offset ||
+      header_->costs_offset != expected.costs_offset ||
+      header_->probabilities_offset != expected.probabilities_offset ||
+      header_->evaluation_times_offset != expected.evaluation_times_offset ||
+      file_.size() < expected.evaluation_times_offset + expected.num_edges *
+      sizeof(double)) {
+    ss << "Roadmap " << path << " (version " << header_->version <<
+       ") does not match the roadmap format (version " << expected.version <<
+       ") or is truncated" << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  heuristics_ = reinterpret_cast<const int32_t *>(file_.data() +
+                                                  header_->heuristics_offset);
+  offsets_ = reinterpret_cast<const uint64_t *>(file_.data() +
+                                                header_->offsets_offset);
+  targets_ = reinterpret_cast<const int32_t *>(file_.data() +
+                                               header_->targets_offset);
+  costs_ = reinterpret_cast<const int32_t *>(file_.data() +
+                                             header_->costs_offset);
+  probabilities_ = reinterpret_cast<const double *>(file_.data() +
+                                                    header_->probabilities_offset);
+  evaluation_times_ = reinterpret_cast<const double *>(file_.data() +
+                                                       header_->evaluation_times_offset);
+}
+
+CompiledGraph RoadmapFile::ToCompiledGraph() const {
+  const size_t num_vertices = NumVertices();
+  const size_t num_edges = NumEdges();
+  bool in_range = offsets_[0] == 0 && offsets_[num_vertices] == num_edges;
+
+  for (size_t ii = 0; in_range && ii < num_vertices; ++ii) {
+    in_range = offsets_[ii] <= offsets_[ii + 1];
+  }
+
+  for (size_t edge_id = 0; in_range && edge_id < num_edges; ++edge_id) {
+    in_range = targets_[edge_id] >= 0 &&
+               static_cast<size_t>(targets_[edge_id]) < num_vertices &&
+               costs_[edge_id] >= 0;
+  }
+
+  if (!in_range) {
+    std::ostringstream ss;
+    ss << "Roadmap " << file_.path() << " has edges out of range or negative"
+       << " edge costs" << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  CompiledGraph compiled;
+  compiled.offsets.assign(offsets_, offsets_ + num_vertices + 1);
+  compiled.targets.assign(targets_, targets_ + num_edges);
+  compiled.costs.assign(costs_, costs_ + num_edges);
+  compiled.BuildReverseIndex();
+  return compiled;
+}
+
+void WriteRoadmap(const std::string &path, const CompiledGraph &graph,
+                  const std::vector<int> &heuristics,
+                  const std::vector<double> &probabilities,
+                  const std::vector<double> &evaluation_times) {
+  const size_t num_vertices = graph.NumVertices();
+  const size_t num_edges = graph.NumEdges();
+
+  if (heuristics.size() != num_vertices ||
+      (!probabilities.empty() && probabilities.size() != num_edges) ||
+      (!evaluation_times.empty() && evaluation_times.size() != num_edges)) {
+    std::ostringstream ss;
+    ss << "Roadmap " << path << " needs " << num_vertices << " heuristics and "
+       << num_edges << " edge properties" << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  // Negative costs, including those of removed edges, would load as removed
+  // edges that are not counted as such.
+  const bool has_negative_costs = std::any_of(graph.costs.begin(),
+  graph.costs.end(), [](int cost) {
+    return cost < 0;
+  });
+
+  if (has_negative_costs) {
+    std::ostringstream ss;
+    ss << "Roadmap " << path << " cannot have negative edge costs" << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  std::vector<uint64_t> offsets(graph.offsets.begin(), graph.offsets.end());
+
+  if (offsets.empty()) {
+    offsets.push_back(0);
+  }
+
+  const std::vector<double> default_probabilities(probabilities.empty() ?
+                                                  num_edges : 0, 1.0);
+  const std::vector<double> default_evaluation_times(evaluation_times.empty() ?
+                                                     num_edges : 0, 0.0);
+  WriteRoadmapArrays(path, MakeRoadmapHeader(num_vertices, num_edges),
+                     heuristics.data(), offsets.data(),
+                     graph.targets.data(), graph.costs.data(),
+                     probabilities.empty() ? default_probabilities.data() : probabilities.data(),
+                     evaluation_times.empty() ? default_evaluation_times.data() :
+                     evaluation_times.data());
+}
+
+void ImportEdgeList(const std::string &text_path,
+                    const std::string &roadmap_path, bool undirected) {
+  std::ifstream stream(text_path.c_str());
+
+  if (!stream) {
+    std::ostringstream ss;
+    ss << "Failed to open edge list " << text_path << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+
+  // First pass: vertex count, heuristics and out-degrees.
+  std::vector<int32_t> heuristics;
+  std::vector<uint64_t> offsets(1, 0);
+  std::string line;
+  size_t line_number = 0;
+  auto add_vertex = [&](long vertex_id) {
+    if (static_cast<size_t>(vertex_id) >= heuristics.size()) {
+      heuristics.resize(vertex_id + 1, 0);
+      offsets.resize(vertex_id + 2, 0);
+    }
+  };
+
+  while (std::getline(stream, line)) {
+    const EdgeListLine parsed = ParseEdgeListLine(line, text_path, ++line_number);
+
+    if (parsed.type == EdgeListLine::kVertex) {
+      add_vertex(parsed.from);
+      heuristics[parsed.from] = static_cast<int32_t>(parsed.value);
+    } else if (parsed.type == EdgeListLine::kEdge) {
+      add_vertex(std::max(parsed.from, parsed.to));
+      ++offsets[parsed.from + 1];
+
+      if (undirected) {
+        ++offsets[parsed.to + 1];
+      }
+    }
+  }
+
+  const size_t num_vertices = heuristics.size();
+
+  for (size_t ii = 0; ii < num_vertices; ++ii) {
+    offsets[ii + 1] += offsets[ii];
+  }
+
+  // Second pass: the edges, in the order they appear for each source.
+  const size_t num_edges = offsets.back();
+  std::vector<int32_t> targets(num_edges), costs(num_edges);
+  std::vector<double> probabilities(num_edges), evaluation_times(num_edges);
+  std::vector<uint64_t> next_edge(offsets.begin(), offsets.end() - 1);
+  auto add_edge = [&](long from, long to, const EdgeListLine & parsed) {
+    const uint64_t edge_id = next_edge[from]++;
+    targets[edge_id] = static_cast<int32_t>(to);
+    costs[edge_id] = static_cast<int32_t>(parsed.value);
+    probabilities[edge_id] = parsed.probability;
+    evaluation_times[edge_id] = parsed.evaluation_time;
+  };
+
+  stream.clear();
+  stream.seekg(0);
+  line_number = 0;
+
+  while (std::getline(stream, line)) {
+    const EdgeListLine parsed = ParseEdgeListLine(line, text_path, ++line_number);
+
+    if (parsed.type == EdgeListLine::kEdge) {
+      add_edge(parsed.from, parsed.to, parsed);
+
+      if (undirected) {
+        add_edge(parsed.to, parsed.from, parsed);
+      }
+    }
+  }
+
+  WriteRoadmapArrays(roadmap_path, MakeRoadmapHeader(num_vertices, num_edges),
+                     heuristics.data(), offsets.data(), targets.data(), costs.data(),
+                     probabilities.data(), evaluation_times.data());
+}
+}  // namespace sbpl_utils
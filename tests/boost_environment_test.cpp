@@ -1,8 +1,16 @@
 #include <sbpl_utils/environments/boost_graph_environment.h>
 #include <sbpl/headers.h>
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <stdexcept>
 
+#include <stdlib.h>
+#include <unistd.h>
+
 #include <gtest/gtest.h>
 
 using namespace sbpl_utils;
@@ -156,9 +164,598 @@ void TEST_STOCHASTIC_GRAPH() {
   cout << "Heuristic: " << bg_env.GetGoalHeuristic(parent_id) << endl;
 }
 
+// Successors read from the compiled CSR arrays must match boost's out-edges.
+template <class Graph>
+void TEST_COMPILED_GRAPH() {
+  const int kNumVertices = 200;
+  Graph g(kNumVertices);
+  auto edge_cost_map = get(&EdgeWithCost::cost, g);
+
+  for (int ii = 0; ii < 5 * kNumVertices; ++ii) {
+    const int from = (ii * 7919) % kNumVertices;
+    const int to = (ii * 104729 + 13) % kNumVertices;
+    edge_cost_map[add_edge(from, to, g).first] = ii;
+  }
+
+  BGEnvironment<Graph> bg_env(g);
+  const CompiledGraph &compiled = bg_env.compiled_graph();
+
+  if (compiled.NumVertices() != num_vertices(g)) {
+    throw std::runtime_error("Compiled graph has the wrong number of vertices");
+  }
+
+  vector<int> succ_ids, costs;
+  size_t num_compiled_edges = 0;
+
+  for (int vertex_id = 0; vertex_id < kNumVertices; ++vertex_id) {
+    bg_env.GetSuccs(vertex_id, &succ_ids, &costs);
+    num_compiled_edges += succ_ids.size();
+    size_t ii = 0;
+
+    for (const auto &edge : make_iterator_range(out_edges(vertex_id, g))) {
+      if (ii >= succ_ids.size() ||
+          succ_ids[ii] != static_cast<int>(target(edge, g)) ||
+          costs[ii] != edge_cost_map[edge]) {
+        throw std::runtime_error("Compiled successors differ from the graph's");
+      }
+
+      ++ii;
+    }
+
+    if (ii != succ_ids.size()) {
+      throw std::runtime_error("Compiled graph has extra successors");
+    }
+  }
+
+  printf("Compiled graph: %zu vertices, %zu edges\n", compiled.NumVertices(),
+         num_compiled_edges);
+}
+
+// The legacy per-state index arrays are initialized to -1 for every vertex.
+void TEST_STATE_ID_MAPPING() {
+  SimpleGraph g(1000);
+  BGEnvironment<SimpleGraph> bg_env(g);
+
+  if (bg_env.StateID2IndexMapping.size() != num_vertices(g)) {
+    throw std::runtime_error("StateID2IndexMapping has the wrong size");
+  }
+
+  for (const int *entry : bg_env.StateID2IndexMapping) {
+    for (int ii = 0; ii < NUMOFINDICES_STATEID2IND; ++ii) {
+      if (entry[ii] != -1) {
+        throw std::runtime_error("StateID2IndexMapping is not initialized");
+      }
+    }
+  }
+}
+
+// Lazy successors carry optimistic costs until GetTrueCost() evaluates
+// their edges, and every edge is evaluated at most once.
+void TEST_LAZY_EVALUATION() {
+  SimpleDiGraph g(4);
+  auto edge_cost_map = get(&EdgeWithCost::cost, g);
+  edge_cost_map[add_edge(0, 1, g).first] = 10;
+  edge_cost_map[add_edge(0, 2, g).first] = 10;
+  edge_cost_map[add_edge(0, 3, g).first] = 10;
+
+  BGEnvironment<SimpleDiGraph> bg_env(g);
+  // Edges to 1 cost double, edges to 3 are in collision.
+  bg_env.SetEdgeEvaluator([](int, int target_id, size_t) {
+    return target_id == 3 ? -1 : target_id == 1 ? 20 : 10;
+  });
+
+  vector<int> succ_ids, costs;
+  vector<bool> true_costs;
+  bg_env.GetLazySuccs(0, &succ_ids, &costs, &true_costs);
+
+  if (succ_ids.size() != 3 || costs != vector<int>({10, 10, 10}) ||
+      true_costs != vector<bool>({false, false, false}) ||
+      bg_env.NumEdgeEvaluations() != 0) {
+    throw std::runtime_error("Lazy successors were evaluated");
+  }
+
+  if (bg_env.GetTrueCost(0, 1) != 20 || bg_env.GetTrueCost(0, 1) != 20 ||
+      bg_env.GetTrueCost(0, 3) != -1 || bg_env.GetTrueCost(1, 0) != -1 ||
+      bg_env.NumEdgeEvaluations() != 2) {
+    throw std::runtime_error("True costs are wrong or not memoized");
+  }
+
+  // Known edges are reported with their true costs, infeasible ones dropped.
+  bg_env.GetLazySuccs(0, &succ_ids, &costs, &true_costs);
+
+  if (succ_ids != vector<int>({1, 2}) || costs != vector<int>({20, 10}) ||
+      true_costs != vector<bool>({true, false})) {
+    throw std::runtime_error("Memoized evaluations are not reported");
+  }
+
+  bg_env.GetSuccs(0, &succ_ids, &costs);
+
+  if (succ_ids != vector<int>({1, 2}) || costs != vector<int>({20, 10}) ||
+      bg_env.NumEdgeEvaluations() != 3) {
+    throw std::runtime_error("Evaluated successors are wrong");
+  }
+}
+
+// Predecessors from the reverse index match the graph's in-edges.
+void TEST_PREDECESSORS() {
+  const int kNumVertices = 100;
+  SimpleDiGraph g(kNumVertices);
+  auto edge_cost_map = get(&EdgeWithCost::cost, g);
+
+  for (int ii = 0; ii < 5 * kNumVertices; ++ii) {
+    const int from = (ii * 7919) % kNumVertices;
+    const int to = (ii * 104729 + 13) % kNumVertices;
+    edge_cost_map[add_edge(from, to, g).first] = ii;
+  }
+
+  BGEnvironment<SimpleDiGraph> bg_env(g);
+  vector<int> pred_ids, costs;
+
+  for (int vertex_id = 0; vertex_id < kNumVertices; ++vertex_id) {
+    bg_env.GetPreds(vertex_id, &pred_ids, &costs);
+    vector<pair<int, int>> preds, expected_preds;
+
+    for (size_t ii = 0; ii < pred_ids.size(); ++ii) {
+      preds.emplace_back(pred_ids[ii], costs[ii]);
+    }
+
+    for (const auto &edge : make_iterator_range(in_edges(vertex_id, g))) {
+      expected_preds.emplace_back(source(edge, g), edge_cost_map[edge]);
+    }
+
+    sort(preds.begin(), preds.end());
+    sort(expected_preds.begin(), expected_preds.end());
+
+    if (preds != expected_preds) {
+      throw std::runtime_error("Predecessors differ from the graph's in-edges");
+    }
+  }
+
+  // Infeasible edges are dropped from the predecessors, too.
+  bg_env.SetEdgeEvaluator([](int source_id, int, size_t) {
+    return source_id % 2 == 0 ? -1 : 1;
+  });
+  bg_env.GetPreds(13, &pred_ids, &costs);
+
+  for (size_t ii = 0; ii < pred_ids.size(); ++ii) {
+    if (pred_ids[ii] % 2 == 0 || costs[ii] != 1) {
+      throw std::runtime_error("Evaluated predecessors are wrong");
+    }
+  }
+}
+
+// Edge and heuristic updates take effect without recompiling, and are logged.
+void TEST_INCREMENTAL_UPDATES() {
+  SimpleGraph g(4);
+  auto edge_cost_map = get(&EdgeWithCost::cost, g);
+  edge_cost_map[add_edge(0, 1, g).first] = 10;
+  edge_cost_map[add_edge(1, 2, g).first] = 10;
+  edge_cost_map[add_edge(0, 2, g).first] = 30;
+  edge_cost_map[add_edge(2, 3, g).first] = 10;
+
+  BGEnvironment<SimpleGraph> bg_env(g);
+  vector<int> succ_ids, costs, changed_state_ids;
+
+  if (!bg_env.UpdateEdgeCost(2, 0, 5) || bg_env.GetTrueCost(0, 2) != 5 ||
+      bg_env.GetTrueCost(2, 0) != 5) {
+    throw std::runtime_error("Edge cost was not updated in both directions");
+  }
+
+  if (!bg_env.RemoveEdge(0, 1) || bg_env.GetTrueCost(1, 0) != -1 ||
+      bg_env.RemoveEdge(0, 3)) {
+    throw std::runtime_error("Edge was not removed");
+  }
+
+  bg_env.GetSuccs(0, &succ_ids, &costs);
+
+  if (succ_ids != vector<int>({2}) || costs != vector<int>({5})) {
+    throw std::runtime_error("Successors do not reflect the updates");
+  }
+
+  // Negative costs would read as removed edges.
+  bool threw = false;
+
+  try {
+    bg_env.UpdateEdgeCost(2, 3, -1);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+
+  if (!threw || bg_env.GetTrueCost(2, 3) != 10) {
+    throw std::runtime_error("Negative edge cost was accepted");
+  }
+
+  // Also when the graph is compiled.
+  SimpleGraph negative_g(g);
+  edge_cost_map = get(&EdgeWithCost::cost, negative_g);
+  edge_cost_map[add_edge(3, 0, negative_g).first] = -1;
+  threw = false;
+
+  try {
+    BGEnvironment<SimpleGraph> negative_env(negative_g);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+
+  if (!threw) {
+    throw std::runtime_error("Graph with a negative edge cost was accepted");
+  }
+
+  bg_env.UpdateHeuristic(3, 7);
+  bg_env.GetChangedStateIDs(&changed_state_ids);
+
+  if (bg_env.GetGoalHeuristic(3) != 7 ||
+      changed_state_ids != vector<int>({0, 1, 2, 3})) {
+    throw std::runtime_error("Changed states were not logged");
+  }
+
+  // Removed edges stay infeasible under an edge evaluator.
+  bg_env.RemoveVertex(2);
+  bg_env.SetEdgeEvaluator([](int, int, size_t) {
+    return 1;
+  });
+  bg_env.GetPreds(3, &succ_ids, &costs);
+  bg_env.GetChangedStateIDs(&changed_state_ids);
+
+  if (!succ_ids.empty() || bg_env.NumEdgeEvaluations() != 0 ||
+      changed_state_ids != vector<int>({0, 1, 2, 3})) {
+    throw std::runtime_error("Vertex was not removed");
+  }
+
+  bg_env.UpdateEdgeCost(2, 3, 4);
+
+  if (bg_env.GetTrueCost(3, 2) != 1) {
+    throw std::runtime_error("Updated edge was not re-evaluated");
+  }
+}
+
+// Environments sharing one graph keep their updates to themselves.
+void TEST_SHARED_GRAPH() {
+  auto g = make_shared<StochasticDiGraph>(3);
+  auto edge_bundle_map = get(bo::edge_bundle, *g);
+  edge_bundle_map[add_edge(0, 1, *g).first].cost = 10;
+  edge_bundle_map[add_edge(1, 2, *g).first].cost = 10;
+  (*g)[2].heuristic = 3;
+
+  shared_ptr<const StochasticDiGraph> shared_g = g;
+  BGEnvironment<StochasticDiGraph> first_env(shared_g);
+  BGEnvironment<StochasticDiGraph> second_env(shared_g);
+  first_env.UpdateEdgeCost(0, 1, 20);
+  first_env.UpdateHeuristic(2, 5);
+  first_env.SetEdgeEvaluator([](int, int, size_t) {
+    return 30;
+  });
+  first_env.GetTrueCost(1, 2);
+
+  if (first_env.GetTrueCost(0, 1) != 30 || second_env.GetTrueCost(0, 1) != 10 ||
+      first_env.GetGoalHeuristic(2) != 5 || second_env.GetGoalHeuristic(2) != 3 ||
+      (*g)[*out_edges(0, *g).first].cost != 10 ||
+      (*g)[*out_edges(1, *g).first].evaluation_time != 0.0) {
+    throw std::runtime_error("Shared graph was modified");
+  }
+
+  StochasticDiGraph moved_g(*g);
+  BGEnvironment<StochasticDiGraph> moved_env(std::move(moved_g));
+
+  if (num_vertices(moved_env.graph()) != 3 || moved_env.GetTrueCost(1, 2) != 10) {
+    throw std::runtime_error("Moved graph was not taken over");
+  }
+}
+
+// Creates an empty file with a unique name, so that concurrent runs do not
+// collide.
+string MakeTempFile() {
+  char path[] = "/tmp/boost_environment_test_XXXXXX";
+  const int fd = mkstemp(path);
+
+  if (fd < 0) {
+    throw std::runtime_error("Failed to create a temporary file");
+  }
+
+  close(fd);
+  return path;
+}
+
+// Roadmaps written from a graph or imported from text load into the same
+// environment as the graph itself.
+void TEST_ROADMAP_FILE() {
+  const string roadmap_path = MakeTempFile();
+  const string text_path = MakeTempFile();
+  StochasticGraph g(4);
+  auto edge_bundle_map = get(bo::edge_bundle, g);
+  auto edge = add_edge(0, 1, g).first;
+  edge_bundle_map[edge].cost = 10;
+  edge_bundle_map[edge].probability = 0.5;
+  edge_bundle_map[add_edge(1, 2, g).first].cost = 20;
+  edge_bundle_map[add_edge(2, 3, g).first].cost = 30;
+  g[3].heuristic = 7;
+
+  WriteRoadmap(roadmap_path, g);
+  BGEnvironment<StochasticGraph> graph_env(g);
+  unique_ptr<BGEnvironment<StochasticGraph>> roadmap_env;
+
+  {
+    // The environment does not need the file once loaded.
+    RoadmapFile roadmap(roadmap_path);
+
+    if (roadmap.NumVertices() != 4 || roadmap.NumEdges() != 6 ||
+        roadmap.probabilities()[0] != 0.5 || roadmap.probabilities()[5] != 1.0) {
+      throw std::runtime_error("Roadmap does not match the graph");
+    }
+
+    roadmap_env.reset(new BGEnvironment<StochasticGraph>(roadmap));
+  }
+
+  ofstream text(text_path.c_str());
+  text << "# Same graph, as text.\n"
+       << "v 3 7\n"
+       << "e 0 1 10 0.5 1.5\n"
+       << "e 1 2 20\n"
+       << "e 2 3 30\n";
+  text.close();
+  ImportEdgeList(text_path, roadmap_path, true);
+  RoadmapFile imported_roadmap(roadmap_path);
+
+  if (imported_roadmap.evaluation_times()[0] != 1.5 ||
+      imported_roadmap.evaluation_times()[5] != 0.0) {
+    throw std::runtime_error("Imported edge properties are wrong");
+  }
+
+  BGEnvironment<StochasticGraph> imported_env(imported_roadmap);
+
+  if (imported_env.EdgeProbability(0) != 0.5 ||
+      imported_env.EdgeEvaluationTime(0) != 1.5 ||
+      imported_env.EdgeProbability(5) != 1.0 || graph_env.EdgeProbability(0) != 0.5) {
+    throw std::runtime_error("Roadmap edge properties were not loaded");
+  }
+
+  for (int vertex_id = 0; vertex_id < 4; ++vertex_id) {
+    vector<int> expected_succ_ids, expected_costs, succ_ids, costs;
+    graph_env.GetSuccs(vertex_id, &expected_succ_ids, &expected_costs);
+    sort(expected_succ_ids.begin(), expected_succ_ids.end());
+    sort(expected_costs.begin(), expected_costs.end());
+
+    for (auto *env : {roadmap_env.get(), &imported_env}) {
+      env->GetSuccs(vertex_id, &succ_ids, &costs);
+      sort(succ_ids.begin(), succ_ids.end());
+      sort(costs.begin(), costs.end());
+
+      if (succ_ids != expected_succ_ids || costs != expected_costs ||
+          env->GetGoalHeuristic(vertex_id) != graph_env.GetGoalHeuristic(vertex_id)) {
+        throw std::runtime_error("Roadmap environment differs from the graph's");
+      }
+    }
+  }
+
+  // Updates work without a boost graph.
+  imported_env.UpdateEdgeCost(1, 0, 5);
+
+  if (imported_env.GetTrueCost(0, 1) != 5) {
+    throw std::runtime_error("Roadmap edge cost was not updated");
+  }
+
+  // Out-of-range values are rejected rather than truncated, and negative
+  // costs rather than loaded as removed edges.
+  for (const char *bad_line : {
+         "e 0 1 -1", "e 0 4294967296 1", "e 0 1 4294967296", "v -1 0"
+       }) {
+    text.open(text_path.c_str());
+    text << "e 0 1 10\n" << bad_line << "\n";
+    text.close();
+    bool threw = false;
+
+    try {
+      ImportEdgeList(text_path, roadmap_path);
+    } catch (const std::runtime_error &error) {
+      threw = string(error.what()).find("line 2") != string::npos;
+    }
+
+    if (!threw) {
+      throw std::runtime_error(string("Edge list line was not rejected: ") + bad_line);
+    }
+  }
+
+  bool threw = false;
+  edge_bundle_map[edge].cost = -1;
+
+  try {
+    WriteRoadmap(roadmap_path, g);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+
+  if (!threw) {
+    throw std::runtime_error("Negative edge cost was written");
+  }
+
+  // A corrupt edge count whose offsets wrap around to the real ones is
+  // rejected rather than read out of bounds.
+  edge_bundle_map[edge].cost = 10;
+  WriteRoadmap(roadmap_path, g);
+  {
+    const uint64_t num_edges = RoadmapFile(roadmap_path).NumEdges() +
+                               (uint64_t(1) << 62);
+    std::fstream stream(roadmap_path.c_str(),
+                        std::ios::binary | std::ios::in | std::ios::out);
+    stream.seekp(offsetof(RoadmapHeader, num_edges));
+    stream.write(reinterpret_cast<const char *>(&num_edges), sizeof(num_edges));
+  }
+  threw = false;
+
+  try {
+    RoadmapFile corrupt_roadmap(roadmap_path);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+
+  if (!threw) {
+    throw std::runtime_error("Roadmap with an overflowing edge count was read");
+  }
+
+  remove(roadmap_path.c_str());
+  remove(text_path.c_str());
+}
+
+// Goal heuristics are the costs-to-go, and are recomputed after updates.
+void TEST_GOAL_HEURISTICS() {
+  SimpleDiGraph g(5);
+  auto edge_cost_map = get(&EdgeWithCost::cost, g);
+  edge_cost_map[add_edge(0, 1, g).first] = 10;
+  edge_cost_map[add_edge(1, 2, g).first] = 10;
+  edge_cost_map[add_edge(0, 2, g).first] = 25;
+  edge_cost_map[add_edge(2, 3, g).first] = 5;
+  // Vertex 4 cannot reach the goal, and edges of unset cost do not overflow.
+  add_edge(3, 4, g);
+
+  BGEnvironment<SimpleDiGraph> bg_env(g);
+  bg_env.ComputeGoalHeuristics(3);
+
+  if (bg_env.GetGoalHeuristic(0) != 25 || bg_env.GetGoalHeuristic(1) != 15 ||
+      bg_env.GetGoalHeuristic(3) != 0 ||
+      bg_env.GetGoalHeuristic(4) != INFINITECOST) {
+    throw std::runtime_error("Goal heuristics are not the costs-to-go");
+  }
+
+  bg_env.ComputeGoalHeuristics(4);
+
+  if (bg_env.GetGoalHeuristic(3) != INFINITECOST) {
+    throw std::runtime_error("Goal heuristics overflowed");
+  }
+
+  bg_env.RemoveEdge(0, 1);
+  bg_env.ComputeGoalHeuristics(3);
+
+  if (bg_env.GetGoalHeuristic(0) != 30) {
+    throw std::runtime_error("Goal heuristics were not recomputed");
+  }
+
+  // Lowering a cost updates the active goal's heuristics and logs them.
+  vector<int> changed_state_ids;
+  bg_env.GetChangedStateIDs(&changed_state_ids);
+  bg_env.UpdateEdgeCost(0, 2, 1);
+  bg_env.GetChangedStateIDs(&changed_state_ids);
+
+  if (bg_env.GetGoalHeuristic(0) != 6 || changed_state_ids != vector<int>({0, 2})) {
+    throw std::runtime_error("Goal heuristics went stale after an update");
+  }
+
+  bool threw = false;
+
+  try {
+    bg_env.ComputeGoalHeuristics(5);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+
+  if (!threw) {
+    throw std::runtime_error("Invalid goal was accepted");
+  }
+
+  // Overridden heuristics are not recomputed.
+  bg_env.UpdateHeuristic(0, 1);
+  bg_env.UpdateEdgeCost(0, 2, 2);
+
+  if (bg_env.GetGoalHeuristic(0) != 1) {
+    throw std::runtime_error("Overridden heuristic was recomputed");
+  }
+}
+
+// Exposes the environment's copy of the graph.
+template <class Graph>
+class InspectableBGEnvironment : public BGEnvironment<Graph> {
+ public:
+  using BGEnvironment<Graph>::BGEnvironment;
+  using BGEnvironment<Graph>::graph_;
+};
+
+// Evaluating on several threads gives the same successors as evaluating
+// serially, and records evaluation times in the edge bundles.
+void TEST_PARALLEL_EVALUATION() {
+  const int kNumVertices = 50;
+  StochasticDiGraph g(kNumVertices);
+  auto edge_bundle_map = get(bo::edge_bundle, g);
+
+  for (int from = 0; from < kNumVertices; ++from) {
+    for (int to = 0; to < kNumVertices; ++to) {
+      edge_bundle_map[add_edge(from, to, g).first].cost = 1 + (from + to) % 7;
+    }
+  }
+
+  // Slow enough to be measurable; every third edge is infeasible.
+  auto evaluator = [](int source_id, int target_id, size_t) {
+    volatile int sum = 0;
+
+    for (int ii = 0; ii < 10000; ++ii) {
+      sum = sum + ii;
+    }
+
+    return (source_id + target_id) % 3 == 0 ? -1 : 10 + (source_id * target_id) % 5;
+  };
+
+  InspectableBGEnvironment<StochasticDiGraph> serial_env(g);
+  InspectableBGEnvironment<StochasticDiGraph> parallel_env(g);
+  serial_env.SetEdgeEvaluator(evaluator);
+  parallel_env.SetEdgeEvaluator(evaluator);
+  parallel_env.SetNumEvaluationThreads(4);
+
+  vector<int> serial_succ_ids, serial_costs, parallel_succ_ids, parallel_costs;
+
+  for (int vertex_id = 0; vertex_id < kNumVertices / 2; ++vertex_id) {
+    serial_env.GetSuccs(vertex_id, &serial_succ_ids, &serial_costs);
+    parallel_env.GetSuccs(vertex_id, &parallel_succ_ids, &parallel_costs);
+
+    if (serial_succ_ids != parallel_succ_ids || serial_costs != parallel_costs) {
+      throw std::runtime_error("Parallel evaluation changed the successors");
+    }
+  }
+
+  vector<pair<int, int>> pending_edges;
+
+  for (int vertex_id = kNumVertices / 2; vertex_id < kNumVertices; ++vertex_id) {
+    pending_edges.emplace_back(vertex_id, 0);
+    pending_edges.emplace_back(vertex_id, 1);
+  }
+
+  parallel_env.EvaluateEdges(pending_edges);
+  const size_t num_evaluations = parallel_env.NumEdgeEvaluations();
+
+  for (const auto &edge : pending_edges) {
+    if (parallel_env.GetTrueCost(edge.first, edge.second) != serial_env.GetTrueCost(
+          edge.first, edge.second)) {
+      throw std::runtime_error("Batch evaluation gave different costs");
+    }
+  }
+
+  if (num_evaluations != parallel_env.NumEdgeEvaluations() ||
+      num_evaluations != serial_env.NumEdgeEvaluations()) {
+    throw std::runtime_error("Edges were evaluated more than once");
+  }
+
+  const size_t edge_id = parallel_env.compiled_graph().EdgesBegin(0);
+  const auto out_edge = *out_edges(0, parallel_env.graph_).first;
+
+  if (parallel_env.EdgeEvaluationTime(edge_id) <= 0.0 ||
+      parallel_env.graph_[out_edge].evaluation_time !=
+      parallel_env.EdgeEvaluationTime(edge_id)) {
+    throw std::runtime_error("Evaluation time was not recorded");
+  }
+
+  printf("Evaluated %zu edges on %d threads\n", num_evaluations, 4);
+}
+
 int main() {
   // TODO: convert to gtest.
   TEST_SIMPLE_GRAPH();
   TEST_STOCHASTIC_GRAPH();
+  TEST_COMPILED_GRAPH<SimpleGraph>();
+  TEST_COMPILED_GRAPH<SimpleDiGraph>();
+  TEST_STATE_ID_MAPPING();
+  TEST_LAZY_EVALUATION();
+  TEST_PARALLEL_EVALUATION();
+  TEST_PREDECESSORS();
+  TEST_INCREMENTAL_UPDATES();
+  TEST_SHARED_GRAPH();
+  TEST_ROADMAP_FILE();
+  TEST_GOAL_HEURISTICS();
   TEST_SIMPLE_GRAPH_WITH_PLANNER();
 }
@@ -0,0 +1,289 @@
+#include <sbpl_utils/examples/hashable_states.h>
+#include <sbpl_utils/hash_manager/concurrent_hash_manager.h>
+#include <sbpl_utils/hash_manager/hash_manager.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace sbpl_utils;
+
+namespace {
+// A state whose copies throw while throw_on_copy is set.
+struct ThrowingState {
+  static bool throw_on_copy;
+
+  int x;
+
+  ThrowingState(int x) : x(x) {}
+  ThrowingState(const ThrowingState &other) : x(other.x) {
+    if (throw_on_copy) {
+      throw std::runtime_error("Copy failed");
+    }
+  }
+  ThrowingState(ThrowingState &&other) noexcept : x(other.x) {}
+
+  bool operator==(const ThrowingState &other) const {
+    return x == other.x;
+  }
+  size_t GetHash() const {
+    return std::hash<int>()(x);
+  }
+};
+bool ThrowingState::throw_on_copy = false;
+}  // namespace
+
+TEST(ConcurrentHashManagerTests, SingleThreadTest) {
+  ConcurrentHashManager<StateDiscVector> hash_manager;
+
+  StateDiscVector s1({10, 4, 3});
+  StateDiscVector s2({10, 4, 3});
+  StateDiscVector s3({10, 1, 5});
+  StateDiscVector s4({100, 100, 100});
+
+  const int id1 = hash_manager.GetStateIDForceful(s1);
+  const int id2 = hash_manager.GetStateIDForceful(s2);
+  const int id3 = hash_manager.GetStateIDForceful(s3);
+
+  EXPECT_EQ(id1, 0);
+  EXPECT_EQ(id1, id2);
+  EXPECT_NE(id1, id3);
+  EXPECT_EQ(hash_manager.Size(), 2);
+
+  EXPECT_NO_THROW(hash_manager.GetState(0));
+  EXPECT_THROW(hash_manager.GetState(2), std::runtime_error);
+  EXPECT_FALSE(hash_manager.Exists(2000000));
+
+  EXPECT_EQ(hash_manager.GetStateID(s3), id3);
+  EXPECT_THROW(hash_manager.GetStateID(s4), std::runtime_error);
+
+  hash_manager.Reset();
+  EXPECT_EQ(hash_manager.Size(), 0);
+  EXPECT_FALSE(hash_manager.Exists(s1));
+}
+
+TEST(ConcurrentHashManagerTests, ThrowingCopyTest) {
+  ConcurrentHashManager<ThrowingState> hash_manager;
+  const ThrowingState s1(1), s2(2);
+  EXPECT_EQ(hash_manager.GetStateIDForceful(s1), 0u);
+
+  // A failed insertion reserves no ID.
+  ThrowingState::throw_on_copy = true;
+  EXPECT_THROW(hash_manager.GetStateIDForceful(s2), std::runtime_error);
+  ThrowingState::throw_on_copy = false;
+  EXPECT_EQ(hash_manager.Size(), 1u);
+  EXPECT_FALSE(hash_manager.Exists(s2));
+  EXPECT_FALSE(hash_manager.Exists(1));
+
+  EXPECT_EQ(hash_manager.GetStateIDForceful(s2), 1u);
+  EXPECT_EQ(hash_manager.GetState(1).x, 2);
+  EXPECT_EQ(hash_manager.Size(), 2u);
+}
+
+// Several writers intern overlapping sets of states while readers
+// concurrently dereference every ID that has been published so far.
+TEST(ConcurrentHashManagerTests, StressTest) {
+  const int kNumWriters = 8;
+  const int kNumReaders = 2;
+  // A power of two, so that every odd stride below is a permutation.
+  const int kNumStates = 1 << 14;
+  ConcurrentHashManager<StateDiscVector> hash_manager(16);
+
+  std::vector<std::vector<unsigned int>> ids(kNumWriters,
+                                             std::vector<unsigned int>(kNumStates));
+  std::atomic<bool> writers_done(false);
+  std::atomic<int> reader_errors(0);
+  std::vector<std::thread> threads;
+
+  for (int writer = 0; writer < kNumWriters; ++writer) {
+    threads.emplace_back([&, writer]() {
+      // Every writer covers all states, in a different order.
+      for (int ii = 0; ii < kNumStates; ++ii) {
+        const int state = (ii * (2 * writer + 1) + writer * 7919) % kNumStates;
+        ids[writer][state] = hash_manager.GetStateIDForceful(StateDiscVector({state, state % 13, -state}));
+      }
+    });
+  }
+
+  for (int reader = 0; reader < kNumReaders; ++reader) {
+    threads.emplace_back([&]() {
+      while (!writers_done.load()) {
+        const size_t size = hash_manager.Size();
+
+        for (unsigned int state_id = 0; state_id < size; ++state_id) {
+          if (!hash_manager.Exists(state_id)) {
+            // Published IDs may briefly lag behind Size(); only check the
+            // states that are visible.
+            continue;
+          }
+
+          const StateDiscVector &state = hash_manager.GetState(state_id);
+
+          if (state.coords().size() != 3 || state.coords()[2] != -state.coords()[0]) {
+            ++reader_errors;
+          }
+        }
+
+        std::this_thread::yield();
+      }
+    });
+  }
+
+  for (int writer = 0; writer < kNumWriters; ++writer) {
+    threads[writer].join();
+  }
+
+  writers_done.store(true);
+
+  for (size_t thread = kNumWriters; thread < threads.size(); ++thread) {
+    threads[thread].join();
+  }
+
+  EXPECT_EQ(reader_errors.load(), 0);
+  // Every state got exactly one dense ID, and all writers agree on it.
+  EXPECT_EQ(hash_manager.Size(), kNumStates);
+  std::vector<bool> seen(kNumStates, false);
+
+  for (int state = 0; state < kNumStates; ++state) {
+    const unsigned int state_id = ids[0][state];
+
+    for (int writer = 1; writer < kNumWriters; ++writer) {
+      EXPECT_EQ(ids[writer][state], state_id);
+    }
+
+    ASSERT_LT(state_id, kNumStates);
+    EXPECT_FALSE(seen[state_id]);
+    seen[state_id] = true;
+    EXPECT_EQ(hash_manager.GetState(state_id).coords()[0], state);
+  }
+}
+
+TEST(StateObserverTests, SingleThreadTest) {
+  HashManager<StateDiscVector> hash_manager;
+  hash_manager.GetStateIDForceful(StateDiscVector({0}));
+  StateObserver<StateDiscVector> observer = hash_manager.AddObserver();
+
+  {
+    StateObserver<StateDiscVector>::View view = observer.Read();
+    EXPECT_EQ(view.Size(), 1u);
+    EXPECT_EQ(view.Version(), 0u);
+    EXPECT_EQ(view.GetState(0), StateDiscVector({0}));
+    EXPECT_THROW(view.GetState(1), std::runtime_error);
+  }
+
+  for (int ii = 1; ii < 5000; ++ii) {
+    hash_manager.GetStateIDForceful(StateDiscVector({ii}));
+  }
+
+  // IDs beyond a gap are not published until the gap is filled.
+  hash_manager.InsertState(StateDiscVector({-1}), 5001);
+  StateObserver<StateDiscVector>::View view = observer.Read();
+  EXPECT_EQ(view.Size(), 5000u);
+  EXPECT_FALSE(view.Exists(5001));
+
+  hash_manager.GetStateIDForceful(StateDiscVector({5000}));
+  EXPECT_EQ(view.Size(), 5000u);
+  EXPECT_EQ(observer.Read().Size(), 5002u);
+
+  int num_visited = 0;
+  view.ForEach([&](unsigned int state_id, const StateDiscVector & state) {
+    EXPECT_EQ(state, StateDiscVector({static_cast<int>(state_id)}));
+    ++num_visited;
+  });
+  EXPECT_EQ(num_visited, 5000);
+
+  // The open view keeps the states dropped by Reset() alive.
+  hash_manager.Reset();
+  EXPECT_EQ(view.GetState(4999), StateDiscVector({4999}));
+  hash_manager.GetStateIDForceful(StateDiscVector({7, 7}));
+  EXPECT_EQ(observer.Read().Size(), 1u);
+  EXPECT_EQ(observer.Read().Version(), 1u);
+  EXPECT_EQ(view.Version(), 0u);
+
+  // Compaction renumbers, so it starts a new version, too.
+  hash_manager.GetStateIDForceful(StateDiscVector({8, 8}));
+  hash_manager.Compact(std::vector<unsigned int>(1, 1));
+  EXPECT_EQ(observer.Read().Version(), 2u);
+  EXPECT_EQ(observer.Read().GetState(0), StateDiscVector({8, 8}));
+
+  // Observers outlive the hash manager.
+  std::unique_ptr<HashManager<StateDiscVector>> scoped_hash_manager(new
+                                                                    HashManager<StateDiscVector>());
+  scoped_hash_manager->GetStateIDForceful(StateDiscVector({3}));
+  StateObserver<StateDiscVector> scoped_observer =
+    scoped_hash_manager->AddObserver();
+  scoped_hash_manager.reset();
+  EXPECT_EQ(scoped_observer.Read().GetState(0), StateDiscVector({3}));
+}
+
+// The planner thread keeps adding states and resetting while observers read
+// every state published so far.
+TEST(StateObserverTests, StressTest) {
+  const int kNumReaders = 2;
+  const int kNumQueries = 20;
+  const int kStatesPerQuery = 20000;
+  HashManager<StateDiscVector, FlatStateIndex> hash_manager;
+  std::vector<StateObserver<StateDiscVector>> observers;
+
+  for (int reader = 0; reader < kNumReaders; ++reader) {
+    observers.push_back(hash_manager.AddObserver());
+  }
+
+  std::atomic<bool> planner_done(false);
+  std::atomic<int> reader_errors(0);
+  std::vector<std::thread> readers;
+
+  for (int reader = 0; reader < kNumReaders; ++reader) {
+    readers.emplace_back([&, reader]() {
+      size_t last_size = 0;
+      uint64_t last_version = 0;
+
+      while (!planner_done.load()) {
+        StateObserver<StateDiscVector>::View view = observers[reader].Read();
+
+        // Views only grow within a version.
+        if (view.Version() < last_version || (view.Version() == last_version &&
+                                               view.Size() < last_size)) {
+          ++reader_errors;
+        }
+
+        last_version = view.Version();
+        last_size = view.Size();
+        // Query q is published as version q + 1.
+        view.ForEach([&](unsigned int state_id, const StateDiscVector & state) {
+          if (state.coords().size() != 2 ||
+              state.coords()[0] != static_cast<int>(state_id) ||
+              state.coords()[1] + 1 != static_cast<int>(view.Version())) {
+            ++reader_errors;
+          }
+        });
+      }
+    });
+  }
+
+  for (int query = 0; query < kNumQueries; ++query) {
+    hash_manager.Reset();
+
+    for (int ii = 0; ii < kStatesPerQuery; ++ii) {
+      hash_manager.GetStateIDForceful(StateDiscVector({ii, query}));
+    }
+  }
+
+  planner_done.store(true);
+
+  for (auto &reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(reader_errors.load(), 0);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,12 +1,78 @@
 #include<sbpl_utils/examples/hashable_states.h>
+#include <sbpl_utils/hash_manager/dense_grid_hash_manager.h>
 #include <sbpl_utils/hash_manager/hash_manager.h>
+#include <sbpl_utils/hash_manager/state_data_store.h>
 
 #include <gtest/gtest.h>
 
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 using namespace sbpl_utils;
 
+namespace {
+// A state that counts how often it gets copied or constructed.
+struct CountingState {
+  static int num_constructions;
+  static int num_copies;
+
+  int x;
+  double payload;
+
+  CountingState(int x, double payload = 0.0) : x(x), payload(payload) {
+    ++num_constructions;
+  }
+  CountingState(const CountingState &other) : x(other.x),
+    payload(other.payload) {
+    ++num_constructions;
+    ++num_copies;
+  }
+  CountingState(CountingState &&other) : x(other.x), payload(other.payload) {
+    ++num_constructions;
+  }
+  CountingState &operator=(const CountingState &other) = default;
+  CountingState &operator=(CountingState &&other) = default;
+
+  bool operator==(const CountingState &other) const {
+    return x == other.x;
+  }
+  size_t GetHash() const {
+    return std::hash<int>()(x);
+  }
+};
+int CountingState::num_constructions = 0;
+int CountingState::num_copies = 0;
+
+// A state whose copies throw while throw_on_copy is set.
+struct ThrowingState {
+  static bool throw_on_copy;
+
+  int x;
+
+  ThrowingState(int x) : x(x) {}
+  ThrowingState(const ThrowingState &other) : x(other.x) {
+    if (throw_on_copy) {
+      throw std::runtime_error("Copy failed");
+    }
+  }
+
+  bool operator==(const ThrowingState &other) const {
+    return x == other.x;
+  }
+  size_t GetHash() const {
+    return std::hash<int>()(x);
+  }
+};
+bool ThrowingState::throw_on_copy = false;
+}  // namespace
+
 TEST(HashManagerTests, StateXYTest) {
   HashManager<StateXY> hash_manager;
 
@@ -71,6 +137,645 @@ TEST(HashManagerTests, StateDiscVectorTest) {
   EXPECT_THROW(hash_manager.GetStateID(s4), std::runtime_error);
 }
 
+TEST(HashManagerTests, StateDiscArrayTest) {
+  HashManager<StateDiscArray<3, int16_t>> hash_manager;
+
+  StateDiscArray<3, int16_t> s1({10, 4, 3});
+  StateDiscArray<3, int16_t> s2({10, 4, 3});
+  StateDiscArray<3, int16_t> s3({10, 1, 5});
+  StateDiscArray<3, int16_t> s4({100, 100, 100});
+
+  const int id1 = hash_manager.GetStateIDForceful(s1);
+  const int id2 = hash_manager.GetStateIDForceful(s2);
+  const int id3 = hash_manager.GetStateIDForceful(s3);
+
+  EXPECT_EQ(id1, 0);
+  EXPECT_EQ(id1, id2);
+  EXPECT_NE(id1, id3);
+
+  EXPECT_NO_THROW(hash_manager.GetState(0));
+  EXPECT_THROW(hash_manager.GetState(2), std::runtime_error);
+
+  EXPECT_NO_THROW(hash_manager.GetStateID(s1));
+  EXPECT_THROW(hash_manager.GetStateID(s4), std::runtime_error);
+
+  EXPECT_EQ(sizeof(s1), 3 * sizeof(int16_t));
+  EXPECT_NE(StateDiscArray<3>({1, 2, 3}).GetHash(),
+            StateDiscArray<3>({3, 2, 1}).GetHash());
+  EXPECT_THROW(StateDiscArray<3>({1, 2}), std::runtime_error);
+  EXPECT_THROW((StateDiscArray<3, int16_t>({1, 40000, 3})), std::runtime_error);
+  EXPECT_THROW((StateDiscArray<3, int16_t>({1, -40000, 3})), std::runtime_error);
+  EXPECT_THROW((StateDiscArray<2, uint8_t>({-1, 0})), std::runtime_error);
+  EXPECT_NO_THROW((StateDiscArray<2, int16_t>({-32768, 32767})));
+  EXPECT_NO_THROW((StateDiscArray<2, uint8_t>({0, 255})));
+}
+
+TEST(HashManagerTests, InsertStateWithArbitraryIDsTest) {
+  HashManager<StateXY> hash_manager;
+
+  StateXY s1(1, 2);
+  StateXY s2(3, 4);
+  StateXY s3(5, 6);
+  StateXY s4(7, 8);
+
+  // A small gap stays in the dense storage, a huge ID goes to the sparse
+  // fallback.
+  EXPECT_NO_THROW(hash_manager.InsertState(s1, 1));
+  EXPECT_NO_THROW(hash_manager.InsertState(s2, 4000000000u));
+  EXPECT_EQ(hash_manager.GetStateID(s1), 1);
+  EXPECT_EQ(hash_manager.GetStateID(s2), 4000000000u);
+  EXPECT_EQ(hash_manager.GetState(4000000000u), s2);
+  EXPECT_FALSE(hash_manager.Exists(2));
+
+  // Forceful insertion must skip over IDs that are already taken.
+  EXPECT_EQ(hash_manager.GetStateIDForceful(s3), 0);
+  EXPECT_EQ(hash_manager.GetStateIDForceful(s4), 2);
+
+  // Neither the state nor the ID can be inserted twice.
+  EXPECT_THROW(hash_manager.InsertState(s1, 10), std::runtime_error);
+  EXPECT_THROW(hash_manager.InsertState(StateXY(9, 9), 2), std::runtime_error);
+
+  // References to stored states stay valid as the manager grows.
+  const StateXY &state = hash_manager.GetState(0);
+
+  for (int ii = 0; ii < 10000; ++ii) {
+    hash_manager.GetStateIDForceful(StateXY(ii, -ii));
+  }
+
+  EXPECT_EQ(state, s3);
+  EXPECT_EQ(hash_manager.Size(), 10004);
+}
+
+TEST(HashManagerTests, StateMappingsTest) {
+  HashManager<StateDiscVector> hash_manager;
+
+  for (int ii = 0; ii < 3000; ++ii) {
+    hash_manager.GetStateIDForceful(StateDiscVector({ii, ii % 7, 3}));
+  }
+
+  hash_manager.InsertState(StateDiscVector({-1, -1, -1}), 3000000000u);
+
+  size_t num_entries = 0;
+
+  for (const auto &entry : hash_manager.GetStateMappings()) {
+    EXPECT_EQ(hash_manager.GetStateID(entry.first), entry.second);
+    ++num_entries;
+  }
+
+  EXPECT_EQ(num_entries, hash_manager.Size());
+  EXPECT_EQ(hash_manager.GetStateMappings().size(), 3001);
+
+  // Map lookups, for dense and sparse IDs.
+  const auto mappings = hash_manager.GetStateMappings();
+  auto it = mappings.find(StateDiscVector({2990, 2990 % 7, 3}));
+  ASSERT_TRUE(it != mappings.end());
+  EXPECT_EQ(it->second, 2990u);
+  EXPECT_EQ(std::distance(it, mappings.end()), 11);
+  it = mappings.find(StateDiscVector({-1, -1, -1}));
+  ASSERT_TRUE(it != mappings.end());
+  EXPECT_EQ(it->second, 3000000000u);
+  EXPECT_TRUE(mappings.find(StateDiscVector({-2, -2, -2})) == mappings.end());
+  EXPECT_EQ(mappings.count(StateDiscVector({5, 5, 3})), 1u);
+  EXPECT_EQ(mappings.count(StateDiscVector({5, 4, 3})), 0u);
+  EXPECT_EQ(mappings.at(StateDiscVector({5, 5, 3})), 5u);
+  EXPECT_THROW(mappings.at(StateDiscVector({5, 4, 3})), std::out_of_range);
+}
+
+TEST(HashManagerTests, FlatStateIndexTest) {
+  FlatHashManager<StateDiscVector> hash_manager;
+
+  // Enough states to force several rehashes and long probe sequences.
+  for (int ii = 0; ii < 20000; ++ii) {
+    EXPECT_EQ(hash_manager.GetStateIDForceful(StateDiscVector({ii % 100, ii / 100, 0})),
+              ii);
+  }
+
+  for (int ii = 0; ii < 20000; ++ii) {
+    EXPECT_EQ(hash_manager.GetStateIDForceful(StateDiscVector({ii % 100, ii / 100, 0})),
+              ii);
+  }
+
+  EXPECT_EQ(hash_manager.Size(), 20000);
+  EXPECT_TRUE(hash_manager.Exists(StateDiscVector({5, 5, 0})));
+  EXPECT_FALSE(hash_manager.Exists(StateDiscVector({5, 5, 1})));
+  EXPECT_THROW(hash_manager.GetStateID(StateDiscVector({5, 5, 1})),
+               std::runtime_error);
+  EXPECT_THROW(hash_manager.InsertState(StateDiscVector({5, 5, 0}), 20000),
+               std::runtime_error);
+  EXPECT_NO_THROW(hash_manager.UpdateState(StateDiscVector({5, 5, 0})));
+
+  hash_manager.Reset();
+  EXPECT_EQ(hash_manager.Size(), 0);
+  EXPECT_FALSE(hash_manager.Exists(StateDiscVector({5, 5, 0})));
+  EXPECT_EQ(hash_manager.GetStateIDForceful(StateDiscVector({5, 5, 0})), 0);
+}
+
+TEST(HashManagerTests, BatchInsertionTest) {
+  HashManager<StateDiscVector> batch_hash_manager;
+  FlatHashManager<StateDiscVector> flat_batch_hash_manager;
+  HashManager<StateDiscVector> hash_manager;
+
+  // Batches that span several prefetch blocks and contain duplicates both
+  // within the batch and of earlier batches.
+  for (int batch = 0; batch < 50; ++batch) {
+    std::vector<StateDiscVector> successors;
+
+    for (int ii = 0; ii < 40; ++ii) {
+      successors.push_back(StateDiscVector({batch + ii % 30, ii % 3}));
+    }
+
+    std::vector<unsigned int> batch_ids;
+    std::vector<unsigned int> flat_batch_ids;
+    batch_hash_manager.GetStateIDsForceful(successors, &batch_ids);
+    flat_batch_hash_manager.GetStateIDsForceful(successors, &flat_batch_ids);
+    ASSERT_EQ(batch_ids.size(), successors.size());
+
+    for (size_t ii = 0; ii < successors.size(); ++ii) {
+      const unsigned int state_id = hash_manager.GetStateIDForceful(successors[ii]);
+      EXPECT_EQ(batch_ids[ii], state_id);
+      EXPECT_EQ(flat_batch_ids[ii], state_id);
+    }
+  }
+
+  EXPECT_EQ(batch_hash_manager.Size(), hash_manager.Size());
+  EXPECT_EQ(flat_batch_hash_manager.Size(), hash_manager.Size());
+}
+
+TEST(HashManagerTests, MoveAndEmplaceTest) {
+  FlatHashManager<CountingState> hash_manager;
+  CountingState::num_constructions = 0;
+  CountingState::num_copies = 0;
+
+  // Emplacing constructs exactly once, in place.
+  EXPECT_EQ(hash_manager.EmplaceState(1, 0.5), 0);
+  EXPECT_EQ(CountingState::num_constructions, 1);
+  // Emplacing a duplicate returns the existing ID and keeps one state.
+  EXPECT_EQ(hash_manager.EmplaceState(1, 0.7), 0);
+  EXPECT_EQ(hash_manager.Size(), 1);
+  EXPECT_EQ(hash_manager.GetState(0).payload, 0.5);
+  EXPECT_EQ(hash_manager.EmplaceState(2), 1);
+
+  // Moving in never copies.
+  EXPECT_EQ(hash_manager.GetStateIDForceful(CountingState(3)), 2);
+  EXPECT_EQ(hash_manager.GetStateIDForceful(CountingState(3)), 2);
+  hash_manager.UpdateState(CountingState(3, 1.5));
+  EXPECT_EQ(CountingState::num_copies, 0);
+  EXPECT_EQ(hash_manager.GetState(2).payload, 1.5);
+
+  // Copying in copies once.
+  const CountingState s4(4);
+  EXPECT_EQ(hash_manager.GetStateIDForceful(s4), 3);
+  EXPECT_EQ(CountingState::num_copies, 1);
+
+  // Looking up existing states neither copies nor moves them.
+  CountingState s3(3);
+  CountingState::num_constructions = 0;
+  EXPECT_EQ(hash_manager.GetStateIDForceful(s4), 3);
+  EXPECT_EQ(hash_manager.GetStateIDForceful(std::move(s3)), 2);
+  EXPECT_EQ(CountingState::num_constructions, 0);
+
+  // Neither does a batch made only of existing states.
+  const std::vector<CountingState> batch = {CountingState(1), CountingState(2),
+                                            CountingState(3), CountingState(4)
+                                           };
+  std::vector<unsigned int> state_ids;
+  CountingState::num_constructions = 0;
+  hash_manager.GetStateIDsForceful(batch, &state_ids);
+  EXPECT_EQ(state_ids, std::vector<unsigned int>({0, 1, 2, 3}));
+  EXPECT_EQ(CountingState::num_constructions, 0);
+
+  // In-place modification keeps the ID.
+  hash_manager.ModifyState(3, [](CountingState & state) {
+    state.payload = 2.5;
+  });
+  EXPECT_EQ(hash_manager.GetState(hash_manager.GetStateID(s4)).payload, 2.5);
+  EXPECT_THROW(hash_manager.ModifyState(4, [](CountingState &) {}),
+               std::runtime_error);
+  EXPECT_THROW(hash_manager.UpdateState(CountingState(5)), std::runtime_error);
+}
+
+TEST(HashManagerTests, ThrowingCopyTest) {
+  FlatHashManager<ThrowingState> hash_manager;
+  const ThrowingState s1(1), s2(2);
+  EXPECT_EQ(hash_manager.GetStateIDForceful(s1), 0);
+
+  // A failed insertion leaves nothing behind in the index or the store.
+  ThrowingState::throw_on_copy = true;
+  EXPECT_THROW(hash_manager.GetStateIDForceful(s2), std::runtime_error);
+  ThrowingState::throw_on_copy = false;
+  EXPECT_EQ(hash_manager.Size(), 1);
+  EXPECT_FALSE(hash_manager.Exists(s2));
+  EXPECT_FALSE(hash_manager.Exists(1));
+
+  EXPECT_EQ(hash_manager.GetStateIDForceful(s2), 1);
+  EXPECT_EQ(hash_manager.GetStateIDForceful(s2), 1);
+  EXPECT_EQ(hash_manager.GetStateID(s1), 0);
+
+  // A failed batch insertion leaves no IDs without states behind.
+  const std::vector<ThrowingState> batch = {ThrowingState(1), ThrowingState(3),
+                                            ThrowingState(4)
+                                           };
+  std::vector<unsigned int> state_ids;
+  ThrowingState::throw_on_copy = true;
+  EXPECT_THROW(hash_manager.GetStateIDsForceful(batch, &state_ids),
+               std::runtime_error);
+  ThrowingState::throw_on_copy = false;
+  EXPECT_EQ(hash_manager.Size(), 2);
+  EXPECT_FALSE(hash_manager.Exists(ThrowingState(3)));
+
+  hash_manager.GetStateIDsForceful(batch, &state_ids);
+  EXPECT_EQ(state_ids, std::vector<unsigned int>({0, 2, 3}));
+  EXPECT_EQ(hash_manager.GetStateIDForceful(ThrowingState(4)), 3);
+}
+
+TEST(HashManagerTests, DenseGridHashManagerTest) {
+  DenseGridHashManager<StateXYTheta> hash_manager({{-100, -100, 0}},
+                                                  {{999, 999, 15}});
+  EXPECT_EQ(hash_manager.NumAllocatedPages(), 0u);
+
+  StateXYTheta s1(-100, 5, 3);
+  StateXYTheta s2(-100, 5, 3);
+  StateXYTheta s3(999, 999, 15);
+  StateXYTheta s4(1000, 0, 0);
+
+  const int id1 = hash_manager.GetStateIDForceful(s1);
+  const int id2 = hash_manager.GetStateIDForceful(s2);
+  const int id3 = hash_manager.GetStateIDForceful(s3);
+
+  EXPECT_EQ(id1, 0);
+  EXPECT_EQ(id1, id2);
+  EXPECT_EQ(id3, 1);
+  EXPECT_EQ(hash_manager.Size(), 2u);
+  // Only the pages of the two inserted cells were allocated.
+  EXPECT_EQ(hash_manager.NumAllocatedPages(), 2u);
+
+  EXPECT_EQ(hash_manager.GetStateID(s3), 1u);
+  EXPECT_TRUE(hash_manager.GetCoordinates(id1) == (std::array<int, 3>{{-100, 5, 3}}));
+  EXPECT_THROW(hash_manager.GetCoordinates(2), std::runtime_error);
+
+  EXPECT_FALSE(hash_manager.InBounds(s4));
+  EXPECT_FALSE(hash_manager.Exists(s4));
+  EXPECT_THROW(hash_manager.GetStateID(s4), std::runtime_error);
+  EXPECT_THROW(hash_manager.GetStateIDForceful(s4), std::runtime_error);
+  EXPECT_EQ(hash_manager.GetStateMappings().at(s3), 1u);
+  EXPECT_EQ(hash_manager.GetStateMappings().count(s4), 0u);
+
+  // Lattices whose cell count overflows are rejected up front.
+  const int kMin = std::numeric_limits<int>::min();
+  const int kMax = std::numeric_limits<int>::max();
+  EXPECT_THROW(DenseGridHashManager<StateXYTheta>({{kMin, kMin, 0}},
+                                                  {{kMax, kMax, 15}}), std::runtime_error);
+  EXPECT_THROW(DenseGridHashManager<StateXYTheta>({{kMin, kMin, 0}},
+                                                  {{kMax, kMax, 0}}), std::runtime_error);
+  EXPECT_EQ(hash_manager.Size(), 2u);
+
+  hash_manager.InsertState(StateXYTheta(0, 0, 0), 10);
+  EXPECT_EQ(hash_manager.GetStateID(StateXYTheta(0, 0, 0)), 10u);
+  EXPECT_THROW(hash_manager.InsertState(StateXYTheta(0, 0, 0), 11),
+               std::runtime_error);
+  EXPECT_THROW(hash_manager.InsertState(StateXYTheta(0, 0, 1), 10),
+               std::runtime_error);
+
+  std::vector<unsigned int> state_ids;
+  hash_manager.GetStateIDsForceful({s1, StateXYTheta(1, 1, 1), s3}, &state_ids);
+  EXPECT_EQ(state_ids, (std::vector<unsigned int> {0, 2, 1}));
+
+  hash_manager.Reset();
+  EXPECT_EQ(hash_manager.Size(), 0u);
+  EXPECT_EQ(hash_manager.NumAllocatedPages(), 0u);
+  EXPECT_FALSE(hash_manager.Exists(s1));
+
+  EXPECT_THROW(DenseGridHashManager<StateXY>({{0, 0}}, {{-1, 10}}),
+               std::runtime_error);
+}
+
+TEST(HashManagerTests, SnapshotTest) {
+  const std::string path = testing::TempDir() + "hash_manager_snapshot_test.bin";
+  FlatHashManager<StateXYTheta> hash_manager;
+
+  for (int ii = 0; ii < 1000; ++ii) {
+    hash_manager.GetStateIDForceful(StateXYTheta(ii % 10, ii / 10, ii % 16));
+  }
+
+  hash_manager.InsertState(StateXYTheta(-1, -1, -1), 100000);
+  hash_manager.SaveSnapshot(path);
+
+  {
+    StateSnapshot<StateXYTheta> snapshot(path);
+    ASSERT_EQ(snapshot.Size(), 1001u);
+    EXPECT_EQ(snapshot.StateID(1000), 100000u);
+    ASSERT_NE(snapshot.Find(42), nullptr);
+    EXPECT_EQ(*snapshot.Find(42), hash_manager.GetState(42));
+    EXPECT_EQ(*snapshot.Find(100000), StateXYTheta(-1, -1, -1));
+    EXPECT_EQ(snapshot.Find(1000), nullptr);
+  }
+
+  HashManager<StateXYTheta> warm_started;
+  warm_started.GetStateIDForceful(StateXYTheta(5000, 5000, 0));
+  warm_started.LoadSnapshot(path);
+  EXPECT_EQ(warm_started.Size(), hash_manager.Size());
+
+  for (const auto &entry : hash_manager.GetStateMappings()) {
+    EXPECT_EQ(warm_started.GetStateID(entry.first), entry.second);
+  }
+
+  EXPECT_FALSE(warm_started.Exists(StateXYTheta(5000, 5000, 0)));
+  EXPECT_EQ(warm_started.GetStateIDForceful(StateXYTheta(5000, 5000, 0)), 1000u);
+
+  // Snapshots of a different state type are rejected.
+  EXPECT_THROW(StateSnapshot<StateXY> snapshot(path), std::runtime_error);
+  EXPECT_THROW(StateSnapshot<StateXY> snapshot(path + ".missing"),
+               std::runtime_error);
+
+  // So are corrupt snapshots: duplicate state IDs, and a state count so
+  // large that the expected file size overflows.
+  std::string contents;
+  {
+    std::ifstream stream(path.c_str(), std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(stream),
+                    std::istreambuf_iterator<char>());
+  }
+  const std::string corrupt_path = path + ".corrupt";
+  const auto write_corrupt = [&](size_t offset, const void *data, size_t size) {
+    std::string corrupt = contents;
+    std::memcpy(&corrupt[offset], data, size);
+    std::ofstream stream(corrupt_path.c_str(), std::ios::binary);
+    stream.write(corrupt.data(), corrupt.size());
+  };
+  const uint32_t duplicate_id = 0;
+  write_corrupt(sizeof(StateSnapshotHeader) + sizeof(uint32_t), &duplicate_id,
+                sizeof(duplicate_id));
+  EXPECT_THROW(warm_started.LoadSnapshot(corrupt_path), std::runtime_error);
+  EXPECT_EQ(warm_started.Size(), hash_manager.Size() + 1);
+  const StateSnapshotHeader huge_header =
+    internal::MakeStateSnapshotHeader<StateXYTheta>(uint64_t(1) << 60);
+  write_corrupt(0, &huge_header, sizeof(huge_header));
+  EXPECT_THROW(StateSnapshot<StateXYTheta> snapshot(corrupt_path),
+               std::runtime_error);
+  std::remove(corrupt_path.c_str());
+  std::remove(path.c_str());
+}
+
+TEST(HashManagerTests, StatsTest) {
+  HashManager<StateXY> hash_manager;
+  hash_manager.EnableTiming(true);
+
+  for (int ii = 0; ii < 100; ++ii) {
+    hash_manager.GetStateIDForceful(StateXY(ii, ii));
+  }
+
+  for (int ii = 0; ii < 50; ++ii) {
+    hash_manager.GetStateIDForceful(StateXY(ii, ii));
+  }
+
+  EXPECT_TRUE(hash_manager.Exists(StateXY(1, 1)));
+  EXPECT_FALSE(hash_manager.Exists(StateXY(1, 2)));
+
+  HashManagerStats stats = hash_manager.GetStats();
+  EXPECT_EQ(stats.num_states, 100u);
+  EXPECT_EQ(stats.num_inserts, 100u);
+  EXPECT_EQ(stats.num_lookups, 152u);
+  EXPECT_EQ(stats.num_hits, 51u);
+  EXPECT_GE(stats.num_comparisons, 51u);
+  EXPECT_GT(stats.bytes_used, 100 * sizeof(StateXY));
+  EXPECT_GT(stats.load_factor, 0.0);
+  EXPECT_LE(stats.load_factor, 1.0);
+  EXPECT_GT(stats.lookup_time_ns, 0u);
+
+  const std::string json = stats.ToJson();
+  EXPECT_EQ(json.front(), '{');
+  EXPECT_EQ(json.back(), '}');
+  EXPECT_NE(json.find("\"num_hits\": 51"), std::string::npos);
+
+  // Error paths print a bounded excerpt of the table.
+  testing::internal::CaptureStdout();
+  EXPECT_THROW(hash_manager.GetStateID(StateXY(-1, -1)), std::runtime_error);
+  const std::string output = testing::internal::GetCapturedStdout();
+  EXPECT_NE(output.find("and 90 more states"), std::string::npos);
+
+  hash_manager.ResetStats();
+  stats = hash_manager.GetStats();
+  EXPECT_EQ(stats.num_states, 100u);
+  EXPECT_EQ(stats.num_lookups, 0u);
+  EXPECT_EQ(stats.lookup_time_ns, 0u);
+}
+
+TEST(HashManagerTests, StateDataStoreTest) {
+  HashManager<StateXY> hash_manager;
+  SearchDataStore search_data;
+
+  const unsigned int start_id = hash_manager.GetStateIDForceful(StateXY(0, 0));
+  search_data.EnsureRow(start_id);
+  EXPECT_EQ(search_data.g(start_id), kInfiniteG);
+  EXPECT_EQ(search_data.parent(start_id), kInvalidStateID);
+  EXPECT_FALSE(search_data.IsOpen(start_id));
+
+  search_data.g(start_id) = 0;
+  search_data.flags(start_id) |= SearchDataStore::kOpen;
+
+  std::vector<unsigned int> succ_ids;
+  hash_manager.GetStateIDsForceful({StateXY(1, 0), StateXY(0, 1)}, &succ_ids);
+  search_data.Resize(hash_manager.Size());
+
+  for (unsigned int succ_id : succ_ids) {
+    search_data.g(succ_id) = search_data.g(start_id) + 1;
+    search_data.parent(succ_id) = start_id;
+    search_data.best_action(succ_id) = static_cast<int>(succ_id);
+  }
+
+  search_data.flags(start_id) = SearchDataStore::kClosed;
+  EXPECT_TRUE(search_data.IsClosed(start_id));
+  EXPECT_EQ(search_data.Size(), 3u);
+  EXPECT_EQ(search_data.Column<0>(), (std::vector<int> {0, 1, 1}));
+  EXPECT_EQ(search_data.parent(succ_ids[1]), start_id);
+
+  search_data.ResetRows();
+  EXPECT_EQ(search_data.Size(), 3u);
+  EXPECT_EQ(search_data.g(start_id), kInfiniteG);
+  EXPECT_EQ(search_data.flags(start_id), 0);
+
+  StateDataStore<double, bool> custom(1.5, true);
+  custom.EnsureRow(9);
+  EXPECT_EQ(custom.Size(), 10u);
+  EXPECT_EQ(custom.Get<0>(9), 1.5);
+  EXPECT_TRUE(custom.Get<1>(0));
+  custom.Clear();
+  EXPECT_EQ(custom.Size(), 0u);
+}
+
+template <class HashManagerType>
+void TestGenerationalReset() {
+  HashManagerType hash_manager;
+
+  for (int query = 0; query < 3; ++query) {
+    for (int ii = 0; ii < 5000; ++ii) {
+      EXPECT_EQ(hash_manager.GetStateIDForceful(StateDiscVector({query, ii})),
+                static_cast<unsigned int>(ii));
+    }
+
+    EXPECT_EQ(hash_manager.Size(), 5000u);
+    EXPECT_TRUE(hash_manager.Exists(StateDiscVector({query, 4999})));
+    const size_t bytes_used = hash_manager.GetStats().bytes_used;
+
+    hash_manager.Reset();
+    EXPECT_EQ(hash_manager.Size(), 0u);
+    EXPECT_FALSE(hash_manager.Exists(StateDiscVector({query, 0})));
+    EXPECT_FALSE(hash_manager.Exists(0));
+    EXPECT_TRUE(hash_manager.GetStateMappings().empty());
+    // Memory is kept for the next query.
+    EXPECT_EQ(hash_manager.GetStats().bytes_used, bytes_used);
+  }
+
+  hash_manager.InsertState(StateDiscVector({7}), 3000);
+  EXPECT_EQ(hash_manager.GetStateIDForceful(StateDiscVector({8})), 0u);
+  EXPECT_EQ(hash_manager.GetStateID(StateDiscVector({7})), 3000u);
+
+  hash_manager.SetMaxRetainedStates(1);
+  hash_manager.Reset();
+  EXPECT_LT(hash_manager.GetStats().bytes_used, 64u);
+}
+
+TEST(HashManagerTests, GenerationalResetTest) {
+  TestGenerationalReset<HashManager<StateDiscVector>>();
+  TestGenerationalReset<FlatHashManager<StateDiscVector>>();
+}
+
+template <class StateIndex>
+void TestArenaAllocator() {
+  typedef ArenaAllocator<StateDiscVector> Allocator;
+  MonotonicArena arena(1024);
+  {
+    HashManager<StateDiscVector, StateIndex, Allocator> hash_manager((Allocator(
+                                                                        &arena)));
+
+    for (int ii = 0; ii < 3000; ++ii) {
+      EXPECT_EQ(hash_manager.GetStateIDForceful(StateDiscVector({ii, -ii})),
+                static_cast<unsigned int>(ii));
+    }
+
+    hash_manager.InsertState(StateDiscVector({-1}), 1000000);
+    EXPECT_EQ(hash_manager.GetStateID(StateDiscVector({5, -5})), 5u);
+    EXPECT_EQ(hash_manager.GetState(1000000), StateDiscVector({-1}));
+    EXPECT_EQ(hash_manager.GetStateMappings().size(), 3001u);
+    EXPECT_GT(arena.BytesAllocated(), 3000 * sizeof(StateDiscVector));
+    EXPECT_GE(arena.BytesReserved(), arena.BytesAllocated());
+
+    hash_manager.Reset();
+    EXPECT_EQ(hash_manager.GetStateIDForceful(StateDiscVector({1, 2})), 0u);
+  }
+
+  arena.Release();
+  EXPECT_EQ(arena.BytesReserved(), 0u);
+}
+
+TEST(HashManagerTests, ArenaAllocatorTest) {
+  TestArenaAllocator<ChainedStateIndex>();
+  TestArenaAllocator<FlatStateIndex>();
+
+  MonotonicArena arena(64);
+  void *small = arena.Allocate(3, 1);
+  void *aligned = arena.Allocate(8, 64);
+  void *large = arena.Allocate(1 << 20, 8);
+  EXPECT_NE(small, nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned) % 64, 0u);
+  EXPECT_NE(large, nullptr);
+  EXPECT_EQ(arena.BytesAllocated(), 3u + 8u + (1u << 20));
+}
+
+template <class HashManagerType>
+void TestCompaction() {
+  HashManagerType hash_manager;
+  SearchDataStore search_data;
+
+  for (int ii = 0; ii < 3000; ++ii) {
+    const unsigned int state_id = hash_manager.GetStateIDForceful(StateDiscVector({
+      ii}));
+    search_data.EnsureRow(state_id);
+    search_data.g(state_id) = ii;
+    search_data.parent(state_id) = state_id == 0 ? kInvalidStateID : state_id - 1;
+  }
+
+  hash_manager.InsertState(StateDiscVector({-1}), 1000000);
+
+  // Keep the even states and the far sparse one.
+  const StateIDRemap remap = hash_manager.Compact([](unsigned int,
+  const StateDiscVector & state) {
+    return state.coords()[0] % 2 == 0 || state.coords()[0] < 0;
+  });
+  EXPECT_EQ(remap.NumStates(), 1501u);
+  EXPECT_EQ(hash_manager.Size(), 1501u);
+  EXPECT_EQ(remap[0], 0u);
+  EXPECT_EQ(remap[1], kInvalidStateID);
+  EXPECT_EQ(remap[2998], 1499u);
+  EXPECT_EQ(remap[1000000], 1500u);
+  EXPECT_EQ(remap[5000000], kInvalidStateID);
+
+  for (int ii = 0; ii < 3000; ii += 2) {
+    EXPECT_EQ(hash_manager.GetStateID(StateDiscVector({ii})),
+              static_cast<unsigned int>(ii / 2));
+  }
+
+  EXPECT_EQ(hash_manager.GetState(1500), StateDiscVector({-1}));
+  EXPECT_FALSE(hash_manager.Exists(StateDiscVector({1})));
+  EXPECT_EQ(hash_manager.GetStateIDForceful(StateDiscVector({1})), 1501u);
+
+  search_data.ApplyRemap(remap);
+  EXPECT_EQ(search_data.Size(), 1501u);
+  EXPECT_EQ(search_data.g(1499), 2998);
+  EXPECT_EQ(search_data.g(1500), kInfiniteG);
+  // Odd parents were dropped.
+  EXPECT_EQ(search_data.parent(0), kInvalidStateID);
+  EXPECT_EQ(search_data.parent(1), kInvalidStateID);
+
+  std::vector<unsigned int> live_state_ids = {1501, 3, 3};
+  const StateIDRemap live_remap = hash_manager.Compact(live_state_ids);
+  EXPECT_EQ(hash_manager.Size(), 2u);
+  EXPECT_EQ(live_remap[3], 0u);
+  EXPECT_EQ(hash_manager.GetStateID(StateDiscVector({6})), 0u);
+  EXPECT_EQ(hash_manager.GetStateID(StateDiscVector({1})), 1u);
+
+  live_state_ids = {0, 7};
+  EXPECT_THROW(hash_manager.Compact(live_state_ids), std::runtime_error);
+  EXPECT_EQ(hash_manager.Size(), 2u);
+}
+
+TEST(HashManagerTests, CompactionTest) {
+  TestCompaction<HashManager<StateDiscVector>>();
+  TestCompaction<FlatHashManager<StateDiscVector>>();
+}
+
+TEST(HashManagerTests, HashQualityTest) {
+  // Hashes are order dependent and spread diagonal cells.
+  EXPECT_NE(StateXY(1, 2).GetHash(), StateXY(2, 1).GetHash());
+  EXPECT_NE(StateXY(1, 1).GetHash(), StateXY(2, 2).GetHash());
+  EXPECT_NE(StateDiscVector({1, 2, 3}).GetHash(),
+            StateDiscVector({3, 2, 1}).GetHash());
+  static_assert(HashValues(1, 2) != HashValues(2, 1),
+                "HashValues should be usable at compile time");
+
+  HashManager<StateXY> hash_manager;
+  FlatHashManager<StateXY> flat_hash_manager;
+
+  for (int x = 0; x < 200; ++x) {
+    for (int y = 0; y < 200; ++y) {
+      hash_manager.GetStateIDForceful(StateXY(x, y));
+      flat_hash_manager.GetStateIDForceful(StateXY(x, y));
+    }
+  }
+
+  const HashDiagnostics diagnostics = hash_manager.GetHashDiagnostics();
+  EXPECT_EQ(diagnostics.num_states, 40000);
+  EXPECT_EQ(diagnostics.num_colliding_states, 0);
+  EXPECT_GT(diagnostics.BucketOccupancy(), 0.4);
+  EXPECT_LT(diagnostics.max_probe_length, 16);
+
+  const HashDiagnostics flat_diagnostics = flat_hash_manager.GetHashDiagnostics();
+  EXPECT_EQ(flat_diagnostics.num_states, 40000);
+  EXPECT_EQ(flat_diagnostics.num_occupied_buckets, 40000);
+  EXPECT_EQ(flat_diagnostics.CollisionRate(), 0.0);
+  EXPECT_LT(flat_diagnostics.mean_probe_length, 2.0);
+}
+
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();